@@ -5,6 +5,7 @@
 #include "expr.h"
 #include "config.h"
 #include "ir/function.h"
+#include "llvm_util/compare.h"
 #include "smt/smt.h"
 #include "tools/transform.h"
 #include "util/config.h"
@@ -14,31 +15,68 @@
 
 #include <iostream>
 #include <ostream>
+#include <sstream>
 #include <unordered_map>
 
 namespace minotaur {
 
 static std::ostream NOP_OSTREAM(nullptr);
 
+// one engine serves all the queries of a slice, the solver context and the
+// verifier are kept alive across its candidates. The source is still
+// translated and executed symbolically for each query: the arguments of a
+// shared source are renamed after the constants of each candidate, and the
+// alive2 state of a function belongs to a single transform
 class AliveEngine {
 private:
   llvm::TargetLibraryInfoWrapperPass &TLI;
   std::ostream *debug;
+  smt::smt_initializer smt_init;
+  // what the verifier prints for a query, the only place it tells a timeout
+  // from other failures
+  std::stringstream Log;
+  llvm_util::Verifier verifier;
+  // query timeout in ms
+  unsigned Timeout;
+  bool TimedOut = false;
+  bool Refuted = false;
+  bool Cached = false;
 
+  // the alive2 configuration is global, it is set again before each query
+  // since the two kinds of queries of a slice interleave
+  void configure(bool dpi);
+
+  // with CheckMemory, the memory of tgt must refine the memory of src too.
+  // Domains bounds the reserved constants, by input name.
   util::Errors find_model(tools::Transform &t,
-    std::unordered_map<const IR::Value*, smt::expr>&);
+    std::unordered_map<const IR::Value*, smt::expr>&, bool CheckMemory,
+    const std::unordered_map<std::string, const Domain*> &Domains);
 
 public:
-  AliveEngine(llvm::TargetLibraryInfoWrapperPass &TLI, bool dpi) : TLI(TLI) {
-    util::config::disable_undef_input = true;
-    util::config::disable_poison_input = dpi;
-    util::config::use_exact_fp = dpi;
-    debug = config::debug_tv ? &std::cerr : &NOP_OSTREAM;
+  AliveEngine(llvm::TargetLibraryInfoWrapperPass &TLI)
+    : TLI(TLI), debug(config::debug_tv ? &std::cerr : &NOP_OSTREAM),
+      verifier(TLI, smt_init, Log), Timeout(config::query_to) {
+    verifier.quiet = false;
+  }
+
+  void setTimeout(unsigned Ms) {
+    Timeout = Ms;
+    smt::set_query_timeout(std::to_string(Ms));
   }
 
+  // the constants are kept in the domains of the reserved constants in
+  // Holes, when given
   bool constantSynthesis(llvm::Function&, llvm::Function&,
-    std::unordered_map<llvm::Argument*, llvm::Constant*>&);
-  bool compareFunctions(llvm::Function&, llvm::Function&);
+    std::unordered_map<llvm::Argument*, llvm::Constant*>&,
+    const std::unordered_map<const llvm::Argument*, ReservedConst*> &Holes
+      = {});
+  // with AssumeNoPoison, the inputs are not poison, as in constant synthesis
+  bool compareFunctions(llvm::Function&, llvm::Function&,
+                        bool AssumeNoPoison = false);
+  // the last query was inconclusive rather than refuted
+  bool timedOut() const { return TimedOut; }
+  // the verdict of the last query came from the query cache
+  bool cached() const { return Cached; }
 };
 
 } // namespace minotaur
@@ -0,0 +1,28 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+
+#include <random>
+
+namespace minotaur {
+
+// Runs a single block function, or a slice with an unreachable sink block, on
+// constant arguments by constant folding its instructions. Returns null when
+// some instruction does not fold, e.g. loads or intrinsics llvm does not know
+// how to evaluate; the x86 shifts by an immediate are folded here.
+llvm::Constant *evaluate(llvm::Function &F,
+                         llvm::ArrayRef<llvm::Constant*> Args);
+
+// an input for concrete testing. Round 0 numbers the lanes 1, 2, ... so that
+// lane movements are told apart, later rounds are random.
+llvm::Constant *testInput(llvm::Type *Ty, unsigned Round, std::mt19937_64 &R);
+
+// tgt computes a different value than src where src is well defined. False
+// when the results cannot be compared exactly, e.g. for NaNs.
+bool differs(llvm::Constant *Src, llvm::Constant *Tgt);
+
+}
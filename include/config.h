@@ -22,7 +22,31 @@ extern bool disable_avx512;
 extern bool show_stats;
 extern bool return_first_solution;
 
-extern unsigned slice_to;
+// synthesis timeout per slice in seconds, the budget hands out fractions
+extern double slice_to;
+// SMT query timeout in ms. With query_fast_to set, candidates are first
+// verified with that shorter timeout, and the ones the solver gives up on
+// are retried with query_to and another seed once the others are done
+extern unsigned query_to;
+extern unsigned query_fast_to;
+extern unsigned smt_seed;
+// directory of the on-disk SMT verdict cache, empty to disable it
+extern std::string smt_cache_dir;
+// lane parallel candidates are verified on at least this many lanes first,
+// and only the good ones at full width, 0 to disable
+extern unsigned reduced_lanes;
+// slices of a shape seen before are first solved with the skeleton of its
+// rewrite, see generalize.h
+extern bool generalize;
+// slices are first rewritten by equality saturation over the cached
+// rewrites, see egraph.h
+extern bool egraph;
+// candidates of the same approximate cost are verified in the order of this
+// ranking model, see ranking.h
+extern std::string rank_model;
+// weights of the approximate cost model fitted for the target by
+// minotaur-calibrate, see cost.h
+extern std::string cost_table;
 extern unsigned slicer_max_depth;
 
 llvm::raw_ostream &dbg();
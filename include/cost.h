@@ -6,8 +6,16 @@
 #include "expr.h"
 
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+
+#include <string>
 
 namespace minotaur {
 unsigned get_machine_cost(llvm::Function *F);
+// with config::cost_table, the weights of the instructions are those of
+// the table for their cost keys, and the built-in weights otherwise
 unsigned get_approx_cost (llvm::Function *F);
+// the operation of I and the width in bits of its type, e.g. fadd.128, or
+// empty when I costs nothing
+std::string get_cost_key(llvm::Instruction &I);
 }
\ No newline at end of file
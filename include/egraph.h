@@ -0,0 +1,31 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "enumerator.h"
+#include "expr.h"
+
+#include "llvm/IR/Function.h"
+
+#include <vector>
+
+struct redisContext;
+
+namespace minotaur {
+
+// Equality saturation over the Inst DSL. The slice is lifted into an e-graph
+// of Insts, and the verified rewrites of the cache are applied to it as
+// rules: the slice of a rewrite is the left hand side, with its arguments as
+// pattern variables, and the rewrite is the right hand side. Rules are
+// applied until nothing changes or the e-graph grows past its budget. The
+// cheapest term by the weights of get_approx_cost is extracted, and only
+// that term is verified.
+//
+// The rules are read from redis, from the list of verified rewrites that
+// hAddRule keeps, and stay loaded for the life of the process.
+
+// a rewrite of the slice found by saturation, or nothing
+std::vector<Rewrite> solveBySaturation(Enumerator &EN, llvm::Function &F,
+                                       llvm::Instruction *I, redisContext *c);
+
+}
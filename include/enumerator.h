@@ -6,11 +6,13 @@
 #include "ir/function.h"
 
 #include "expr.h"
+#include "utils.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/IR/Dominators.h"
 
 #include <functional>
 #include <memory>
+#include <optional>
 #include <unordered_map>
 
 namespace llvm {
@@ -22,6 +24,14 @@ namespace minotaur {
 
 using Sketch = std::pair<Inst*, std::set<ReservedConst*>>;
 
+// called after each candidate that reached verification, with its sketch,
+// approximate cost, verification time in seconds and verdict
+using CandidateHook =
+  std::function<void(Inst*, unsigned, double, bool)>;
+
+// the sketches a solve tries first
+using SketchFilter = std::function<bool(Inst*)>;
+
 class Enumerator {
   std::vector<std::unique_ptr<Inst>> exprs;
 
@@ -32,8 +42,27 @@ class Enumerator {
                   llvm::DominatorTree&);
   bool getSketches(llvm::Value *V,
                    std::vector<Sketch>&);
+  CandidateHook OnCandidate;
+
+  // how the last solve went
+  unsigned Candidates = 0, Verified = 0, Timeouts = 0;
+  bool OutOfTime = false;
+  // the machine cost of the slice, while a solve verifies it in two rounds
+  std::optional<unsigned> CostBefore;
 public:
-  std::vector<Rewrite> solve(llvm::Function&, llvm::Instruction*);
+  void setCandidateHook(CandidateHook H) { OnCandidate = std::move(H); }
+  // with First, the sketches it accepts are verified first, and the others
+  // only when none of them holds. FromFirst tells which ones the rewrites
+  // came from. First is called once per sketch.
+  std::vector<Rewrite> solve(llvm::Function&, llvm::Instruction*,
+                             const SketchFilter &First = nullptr,
+                             bool *FromFirst = nullptr);
+  // verifies the given sketches only, Insts are the ones they are made of
+  std::vector<Rewrite> verify(llvm::Function&, llvm::Instruction*,
+                              std::vector<Sketch> &Sketches,
+                              std::vector<std::unique_ptr<Inst>> &&Insts = {});
+  // why the last solve found nothing, and the budget it had
+  NoSolution noSolution() const;
 };
 
 }
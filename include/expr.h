@@ -55,10 +55,34 @@ public:
   llvm::Value *V () { return v; }
 };
 
+// The values a literal constant can take and still be meaningful, from its
+// use in the sketch: indices beyond the last lane and shift amounts beyond
+// the width give poison. A lane range bounds each lane of a vector constant
+// separately.
+struct Domain {
+  enum Kind { Any, Range, Set, LaneRange };
+  Kind K = Any;
+  // Range and LaneRange: [Lo, Hi)
+  uint64_t Lo = 0, Hi = 0;
+  // Set
+  std::vector<uint64_t> Values;
+
+  static Domain range(uint64_t Lo, uint64_t Hi);
+  static Domain set(std::vector<uint64_t> Values);
+  static Domain lanes(uint64_t Lo, uint64_t Hi);
+
+  // the number of values of a scalar domain, 0 when it is not finite
+  uint64_t size() const;
+  // the I-th value of a scalar domain
+  uint64_t value(uint64_t I) const;
+  void print(llvm::raw_ostream &os) const;
+};
+
 // literal constants to be synthesized
 class ReservedConst final : public Value {
   llvm::Argument *A;
   llvm::Constant *C;
+  Domain D;
 public:
   ReservedConst(type t) : Value(t), A(nullptr), C(nullptr) {}
   ReservedConst(type t, llvm::Constant *C) : Value(t), A(nullptr), C(C) {};
@@ -68,6 +92,8 @@ public:
   void print(llvm::raw_ostream &os) const override;
   void setC (llvm::Constant *C) { this->C = C; }
   llvm::Constant *getC () const { return C; }
+  const Domain &getDomain() const { return D; }
+  void setDomain(Domain Dom) { D = std::move(Dom); }
 };
 
 // No-op
@@ -0,0 +1,35 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "enumerator.h"
+#include "expr.h"
+
+#include "llvm/IR/Function.h"
+
+#include <string>
+#include <vector>
+
+struct redisContext;
+
+namespace minotaur {
+
+// A rewrite is generalized to every slice of the same shape: the same
+// instructions over the same operands, whatever their widths, lane counts
+// and constants. What is kept is the skeleton of the rewrite, its
+// operations and the inputs they take. A slice of a known shape is solved by
+// the sketches with that skeleton first, and each of them is verified for
+// the slice at hand, with its own constants.
+
+// the slice without its widths, lane counts and constants
+std::string sliceShape(llvm::Function &F);
+
+// the skeleton of the rewrite or sketch I of the slice F
+std::string rewriteSkeleton(llvm::Function &F, Inst *I);
+
+// solves the slice with the skeleton recorded for its shape, then with the
+// full enumeration, and records the skeleton of a new rewrite
+std::vector<Rewrite> solveByShape(Enumerator &EN, llvm::Function &F,
+                                  llvm::Instruction *I, redisContext *c);
+
+}
@@ -0,0 +1,28 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "llvm/IR/Function.h"
+
+#include <unordered_set>
+
+namespace minotaur {
+
+// A function is lane parallel when all its vectors have the same number of
+// lanes, and each lane is computed from the same lane of the inputs by the
+// same operations: elementwise instructions and intrinsics, splat constants,
+// and scalars only as uniform operands such as shift immediates. When src
+// and tgt are both lane parallel, a lane that breaks refinement breaks it
+// whatever the number of lanes, so the query can be made on fewer lanes.
+
+// the number of lanes, at least MinLanes and fewer than they have, that Src
+// and Tgt can both be narrowed to, or 0
+unsigned reducibleLanes(llvm::Function &Src, llvm::Function &Tgt,
+                        unsigned MinLanes);
+
+// a copy of the lane parallel function F in its module, narrowed to Lanes.
+// The intrinsic declarations it uses are added to Decls.
+llvm::Function *reduceLanes(llvm::Function &F, unsigned Lanes,
+                            std::unordered_set<llvm::Function*> &Decls);
+
+}
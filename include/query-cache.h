@@ -0,0 +1,41 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Function.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace minotaur {
+namespace querycache {
+
+// verdicts of refinement and constant synthesis queries, kept on disk in
+// config::smt_cache_dir so that later builds do not solve them again
+enum Verdict { Valid, Invalid, Timeout };
+
+struct Entry {
+  Verdict V;
+  // the query timeout in ms the verdict was reached with
+  unsigned TimeoutMs;
+  // the constants found, printed, in the order of the reserved constant
+  // arguments of tgt
+  std::vector<std::string> Constants;
+};
+
+bool enabled();
+
+// Kind tells apart the queries that share src and tgt. The datalayout and
+// target triple of the module take part in the key, the function names and
+// the numbering of the reserved constants do not.
+std::string key(llvm::StringRef Kind, llvm::Function &Src,
+                llvm::Function &Tgt);
+
+// a timeout is only reused when it was reached with at least TimeoutMs
+std::optional<Entry> lookup(llvm::StringRef Key, unsigned TimeoutMs);
+void store(llvm::StringRef Key, const Entry &E);
+
+} // namespace querycache
+} // namespace minotaur
@@ -0,0 +1,54 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "expr.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace minotaur {
+
+// A frequency model of which operator families solve which slices, trained
+// by minotaur-rank from the solved and unsolved slices of the cache. A slice
+// is described by features such as the opcode of its root and the
+// operations it contains, a sketch by the operator families it uses. The
+// score of a sketch for a slice is the average log frequency, over the
+// features of the slice and the families of the sketch, with which that
+// family was in the rewrite of a slice with that feature.
+
+// the features of the slice F
+std::vector<std::string> sliceFeatures(llvm::Function &F);
+
+// the operator families of a sketch or rewrite, x86 intrinsics without
+// their isa and width
+std::set<std::string> sketchFamilies(Inst *I);
+
+class RankModel {
+  // slices by feature, and the solved ones by feature and family
+  std::map<std::string, unsigned> Slices;
+  std::map<std::pair<std::string, std::string>, unsigned> Solved;
+
+public:
+  // Families is empty for a slice without a rewrite
+  void add(const std::vector<std::string> &Features,
+           const std::set<std::string> &Families);
+  double score(const std::vector<std::string> &Features,
+               const std::set<std::string> &Families) const;
+  bool empty() const { return Slices.empty(); }
+
+  bool load(llvm::StringRef Path);
+  void write(llvm::raw_ostream &OS) const;
+};
+
+// the model in config::rank_model, loaded on first use, or nullptr
+const RankModel *rankModel();
+
+}
@@ -1,5 +1,7 @@
 // Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
 // Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
 #include "llvm/Analysis/PostDominators.h"
@@ -16,18 +18,24 @@
 
 namespace minotaur {
 
+// slices the expression of a value down to the instructions that become dead
+// once the value is replaced, so the cost of the slice is what a rewrite
+// actually removes from the program. Only the block of the value is looked
+// at: operands from other blocks become arguments of the slice, even when
+// they would die as well.
 class RemovalSlice {
   llvm::Function &VF;
   llvm::LLVMContext &Ctx;
-  llvm::LoopInfo &LI;
-  llvm::DominatorTree &DT;
+  const llvm::LoopInfo &LI;
+  const llvm::DominatorTree &DT;
 
   std::unique_ptr<llvm::Module> M;
   llvm::ValueToValueMapTy mapping;
   bool discarded_at_precheck = false;
 
 public:
-  RemovalSlice(llvm::Function &VF, llvm::LoopInfo &LI, llvm::DominatorTree &DT)
+  RemovalSlice(llvm::Function &VF, const llvm::LoopInfo &LI,
+               const llvm::DominatorTree &DT)
     : VF(VF), Ctx(VF.getContext()), LI(LI), DT(DT) {
 
     for (auto &arg : VF.args()) {
@@ -41,8 +49,8 @@ public:
   }
   std::unique_ptr<llvm::Module> getNewModule() {return std::move(M); }
   llvm::ValueToValueMapTy& getValueMap() { return mapping; }
-  std::optional<std::reference_wrapper<llvm::Function>>
-    extractExpr(llvm::Value &V);
+  std::optional<std::pair<std::reference_wrapper<llvm::Function>,
+    llvm::Instruction*>> extractExpr(llvm::Value &V);
 };
 
 } // namespace minotaur
\ No newline at end of file
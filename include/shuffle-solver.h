@@ -0,0 +1,20 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "expr.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instruction.h"
+
+namespace minotaur {
+
+// Shuffles only move lanes, so the mask of a shuffle sketch follows from
+// where each lane of the slice root comes from. The lanes of Root are traced
+// through shufflevector, extractelement, insertelement and bitcast back to
+// the operands of SV. Returns the mask, or null when Root is not a pure data
+// movement of those operands.
+llvm::Constant *solveShuffleMask(llvm::Instruction *Root,
+                                 FakeShuffleInst *SV);
+
+}
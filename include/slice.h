@@ -1,5 +1,7 @@
 // Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
 // Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
 #include "llvm/Analysis/PostDominators.h"
@@ -11,22 +13,50 @@
 #include "llvm/Transforms/Utils/ValueMapper.h"
 
 #include <functional>
+#include <map>
 #include <optional>
+#include <set>
 
 namespace minotaur {
 
+bool isUnsupportedTy(llvm::Type *ty);
+// checks that depend only on the instruction, not on the value being sliced
+bool canHarvest(llvm::Instruction *i);
+
+// per-function state shared by all slices taken from one function: whether an
+// instruction can be harvested at all, and the blocks on the paths between a
+// pair of blocks. It is only valid as long as the function is not modified.
+class SliceContext {
+  friend class Slice;
+
+  std::map<llvm::Instruction*, bool> harvestable;
+  // nullopt if the walk gave up
+  std::map<std::pair<llvm::BasicBlock*, llvm::BasicBlock*>,
+           std::optional<std::set<llvm::BasicBlock*>>> paths;
+};
+
 class Slice {
   llvm::Function &f;
   const llvm::LoopInfo &LI;
   const llvm::DominatorTree &DT;
 
+  std::unique_ptr<SliceContext> ownedContext;
+  SliceContext &context;
+
   std::unique_ptr<llvm::Module> m;
   llvm::ValueToValueMapTy mapping;
 
 public:
+  Slice(llvm::Function &f, const llvm::LoopInfo &LI,
+        const llvm::DominatorTree &DT, SliceContext &context)
+      : f(f), LI(LI), DT(DT), context(context) {
+    m = std::make_unique<llvm::Module>("", f.getContext());
+    m->setDataLayout(f.getParent()->getDataLayout());
+  }
   Slice(llvm::Function &f, const llvm::LoopInfo &LI,
         const llvm::DominatorTree &DT)
-      : f(f), LI(LI), DT(DT) {
+      : f(f), LI(LI), DT(DT), ownedContext(std::make_unique<SliceContext>()),
+        context(*ownedContext) {
     m = std::make_unique<llvm::Module>("", f.getContext());
     m->setDataLayout(f.getParent()->getDataLayout());
   }
@@ -34,6 +64,11 @@ public:
   llvm::ValueToValueMapTy& getValueMap() { return mapping; }
   std::optional<std::pair<std::reference_wrapper<llvm::Function>,
     llvm::Instruction*>> extractExpr(llvm::Value&);
+
+private:
+  bool isHarvestable(llvm::Instruction *i);
+  bool walk(llvm::BasicBlock *from, llvm::BasicBlock *to,
+            std::set<llvm::BasicBlock*> &blocks);
 };
 
 } // namespace minotaur
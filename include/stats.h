@@ -0,0 +1,84 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "trace.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+namespace minotaur {
+namespace stats {
+
+enum Phase {
+  Slicing,
+  CacheLookup,
+  Sketches,
+  Cloning,
+  ApproxCost,
+  MachineCost,
+  SMT,
+  Codegen,
+  NumPhases
+};
+
+enum Counter {
+  Slices,
+  CacheHits,
+  CacheMisses,
+  Candidates,
+  Pruned,
+  Good,
+  Rewrites,
+  // machine cost of the slices that were rewritten, before and after
+  CostBefore,
+  CostAfter,
+  SMTQueries,
+  // queries the solver gave up on, and those retried with the full timeout
+  SMTTimeouts,
+  SMTRetries,
+  // queries answered by the on-disk query cache
+  SMTCacheHits,
+  // values of small holes ruled out by concrete tests before verification
+  Screened,
+  // slices solved with the skeleton of a rewrite of the same shape
+  ShapeHits,
+  // slices solved by equality saturation over the cached rewrites
+  Saturated,
+  NumCounters
+};
+
+// adds the wall and cpu time spent in its scope to a phase, and to the
+// minotaur timer group when -time-passes is given. The scope is also a trace
+// span named after the phase.
+class PhaseTimer {
+  Phase P;
+  std::chrono::steady_clock::time_point Wall;
+  std::clock_t CPU;
+  trace::Span Span;
+
+public:
+  PhaseTimer(Phase P);
+  ~PhaseTimer();
+  // wall time spent so far, in seconds
+  double elapsed() const;
+};
+
+void count(Counter C, uint64_t N = 1);
+// an SMT query took Seconds, feeds the SMT time histogram
+void recordQuery(double Seconds);
+
+// the statistics are per module, they are reset when M changes
+void enterModule(const llvm::Module &M);
+void print(llvm::raw_ostream &OS);
+// writes the statistics of the current module as JSON, the file is
+// overwritten as the module progresses
+void writeReport(llvm::StringRef Dir);
+
+} // namespace stats
+} // namespace minotaur
@@ -0,0 +1,44 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "llvm/ADT/StringRef.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace minotaur {
+namespace trace {
+
+extern std::atomic<bool> Enabled;
+
+inline bool enabled() { return Enabled.load(std::memory_order_relaxed); }
+
+// starts writing trace events in the Chrome trace event format (loadable in
+// chrome://tracing and Perfetto) to Path, "%p" in Path is replaced by the
+// process id. The file is completed when the process exits.
+void open(llvm::StringRef Path);
+
+// a complete event covering the lifetime of the object, on the calling thread.
+// Nothing is recorded, and arguments are dropped, when tracing is disabled.
+class Span {
+  const char *Name = nullptr;
+  std::chrono::steady_clock::time_point Start;
+  std::vector<std::pair<std::string, std::string>> Args;
+
+public:
+  Span(const char *Name);
+  ~Span();
+  Span(const Span&) = delete;
+  Span &operator=(const Span&) = delete;
+
+  Span &arg(llvm::StringRef Key, llvm::StringRef Value);
+  Span &arg(llvm::StringRef Key, int64_t Value);
+};
+
+} // namespace trace
+} // namespace minotaur
@@ -2,6 +2,8 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 #pragma once
 #include <unordered_set>
+#include <vector>
+#include "llvm/ADT/STLFunctionalExtras.h"
 #include "llvm/IR/Function.h"
 
 struct redisContext;
@@ -9,9 +11,67 @@ struct redisContext;
 namespace minotaur {
 void eliminate_dead_code(llvm::Function &F);
 
+// short stable identifier of a slice, the MD5 of its printed module
+std::string sliceHash(llvm::StringRef Slice);
+
+// slices waiting for an out-of-line synthesizer, see minotaur-worker
+constexpr const char *PENDING_QUEUE = "minotaur:queue";
+// the slices in PENDING_QUEUE, each is queued once
+constexpr const char *PENDING_SET = "minotaur:queue:keys";
+
+// why a slice has no solution and the budget it had, so that later runs only
+// retry the slices they could now solve
+struct NoSolution {
+  // no-infer, malformed, no-candidates, exhausted or timeout
+  std::string Reason;
+  // slice timeout in s and query timeout in ms
+  unsigned SliceTo = 0;
+  unsigned QueryTo = 0;
+  unsigned Candidates = 0;
+  unsigned Timeouts = 0;
+  std::string Version;
+
+  // a newer synthesizer may succeed where an older one did not, as may a
+  // bigger budget when time ran out
+  bool worthRetrying(llvm::StringRef CurVersion, unsigned CurSliceTo,
+                     unsigned CurQueryTo) const;
+};
+
 bool hGet(const char* s, unsigned sz, std::string &Value, redisContext *c);
+bool hGetField(const char* s, unsigned sz, const char *field,
+               std::string &Value, redisContext *c);
+// Weight is the execution weight of the slice root, it is accumulated into
+// the profile field of the entry
+void hIncrProfile(const char*, unsigned, uint64_t Weight, redisContext *c);
 void hSetRewrite(const char*, unsigned, const char *, unsigned, llvm::StringRef,
-                 redisContext *c, unsigned, unsigned, llvm::StringRef);
-void hSetNoSolution(const char*, unsigned, redisContext *c, llvm::StringRef);
+                 redisContext *c, unsigned, unsigned, llvm::StringRef,
+                 uint64_t Weight);
+void hSetNoSolution(const char*, unsigned, redisContext *c, llvm::StringRef,
+                    uint64_t Weight, const NoSolution &NS);
+// entries written before the reasons were recorded have an empty Reason
+void hGetNoSolution(const char*, unsigned, NoSolution &NS, redisContext *c);
+void hSetPending(const char*, unsigned, redisContext *c, llvm::StringRef,
+                 uint64_t Weight);
+bool hPopPending(std::string &Key, redisContext *c, bool block);
+// the slices with a rewrite, in the order they were solved, see egraph.h
+constexpr const char *RULES_LIST = "minotaur:rules";
+// the slices in RULES_LIST, each is listed once
+constexpr const char *RULES_SET = "minotaur:rules:keys";
+// lists the slice in RULES_LIST, unless it already is
+void hAddRule(const char*, unsigned, redisContext *c);
+// appends the slices solved since the From-th one to Keys
+void hGetRules(unsigned From, std::vector<std::string> &Keys,
+               redisContext *c);
+// the skeleton of the rewrites of the slices of a shape, see generalize.h
+constexpr const char *SHAPE_PREFIX = "minotaur:shape:";
+bool hGetShape(llvm::StringRef Shape, std::string &Skeleton, redisContext *c);
+void hSetShape(llvm::StringRef Shape, llvm::StringRef Skeleton,
+               redisContext *c);
+// calls Fn with each cached slice, until it returns false
+void hScanSlices(llvm::function_ref<bool(llvm::StringRef Key)> Fn,
+                 redisContext *c);
+// finds the cached slice whose sliceHash starts with HashPrefix
+bool hFindByHash(llvm::StringRef HashPrefix, std::string &Key,
+                 redisContext *c);
 void removeUnusedDecls(std::unordered_set<llvm::Function *>);
 }
\ No newline at end of file
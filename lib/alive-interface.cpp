@@ -1,13 +1,15 @@
 // Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
 // Distributed under the MIT license that can be found in the LICENSE file.
 #include "alive-interface.h"
+#include "query-cache.h"
 
 #include "ir/globals.h"
-#include "llvm_util/compare.h"
 #include "llvm_util/llvm2alive.h"
 #include "smt/smt.h"
 #include "util/errors.h"
 #include "util/symexec.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/Support/SourceMgr.h"
 
 #include <sstream>
 #include <unordered_map>
@@ -45,19 +47,90 @@ static expr preprocess(Transform &t, const set<expr> &qvars0,
   return expr::mkForAll(qvars, std::move(e));
 }
 
+// the side constraint keeping a reserved constant in its domain
+static expr inDomain(const Domain &D, const IR::Type &Ty,
+                     const StateValue &SV) {
+  auto inRange = [&](const expr &E) {
+    unsigned Bits = E.bits();
+    expr R = E.uge(expr::mkUInt(D.Lo, Bits));
+    if (Bits >= 64 || D.Hi < (uint64_t(1) << Bits))
+      R &= E.ult(expr::mkUInt(D.Hi, Bits));
+    return R;
+  };
+
+  switch (D.K) {
+  case Domain::Any:
+    return true;
+  case Domain::Range:
+    return inRange(SV.value);
+  case Domain::Set: {
+    expr R(false);
+    for (auto V : D.Values)
+      R |= SV.value == expr::mkUInt(V, SV.value.bits());
+    return R;
+  }
+  case Domain::LaneRange: {
+    auto *ATy = Ty.getAsAggregateType();
+    if (!ATy)
+      return inRange(SV.value);
+    expr R(true);
+    for (unsigned I = 0; I < ATy->numElementsConst(); ++I)
+      R &= inRange(ATy->extract(SV, I, false).value);
+    return R;
+  }
+  }
+  UNREACHABLE();
+}
+
+void AliveEngine::configure(bool dpi) {
+  util::config::disable_undef_input = true;
+  util::config::disable_poison_input = dpi;
+  util::config::use_exact_fp = dpi;
+}
+
 bool
-AliveEngine::compareFunctions(llvm::Function &Func1, llvm::Function &Func2) {
-  smt::smt_initializer smt_init;
-  llvm_util::Verifier verifier(TLI, smt_init, *debug);
-  verifier.quiet = false;
-  verifier.compareFunctions(Func1, Func2);
+AliveEngine::compareFunctions(llvm::Function &Func1, llvm::Function &Func2,
+                              bool AssumeNoPoison) {
+  configure(AssumeNoPoison);
+  TimedOut = Cached = false;
+
+  string Key;
+  if (querycache::enabled()) {
+    Key = querycache::key(AssumeNoPoison ? "refinement-np" : "refinement",
+                          Func1, Func2);
+    if (auto E = querycache::lookup(Key, Timeout)) {
+      Cached = true;
+      TimedOut = E->V == querycache::Timeout;
+      return E->V == querycache::Valid;
+    }
+  }
 
-  return verifier.num_correct;
+  // the verifier counts over all the queries of the engine
+  auto Correct = verifier.num_correct;
+  auto Unsound = verifier.num_unsound;
+  Log.str("");
+  verifier.compareFunctions(Func1, Func2);
+  string Out = Log.str();
+  *debug << Out;
+
+  bool Valid = verifier.num_correct > Correct;
+  // other failures, e.g. approximations or unsupported features, are not
+  // worth retrying with a longer timeout
+  TimedOut = !Valid && Out.find("ERROR: Timeout") != string::npos;
+  // solver errors and unsupported features are not recorded
+  bool Refuted = verifier.num_unsound > Unsound;
+  if (!Key.empty() && (Valid || TimedOut || Refuted))
+    querycache::store(Key, {Valid ? querycache::Valid :
+                            TimedOut ? querycache::Timeout :
+                            querycache::Invalid, Timeout, {}});
+  return Valid;
 }
 
 Errors
 AliveEngine::find_model(Transform &t,
-                        unordered_map<const IR::Value*, smt::expr> &result) {
+                        unordered_map<const IR::Value*, smt::expr> &result,
+                        bool CheckMemory,
+                        const unordered_map<string, const Domain*> &Domains) {
 
   t.preprocess();
   t.tgt.syncDataWithSrc(t.src);
@@ -85,6 +158,9 @@ AliveEngine::find_model(Transform &t,
 
   auto uvars = sv.undef_vars;
   set<expr> qvars;
+  // the reserved constants are existentially quantified, their domains are
+  // side constraints outside of the forall
+  expr holes(true);
 
   Errors errs;
 
@@ -97,6 +173,9 @@ AliveEngine::find_model(Transform &t,
       continue;
 
     if (i.getName().rfind("%_reservedc") == 0) {
+      auto It = Domains.find(i.getName());
+      if (It != Domains.end())
+        holes &= inDomain(*It->second, i.getType(), val->val);
       continue;
     }
 
@@ -107,6 +186,11 @@ AliveEngine::find_model(Transform &t,
       continue;
     }
 
+    if (ty.isPtrType()) {
+      qvars.insert(val->val.value);
+      continue;
+    }
+
     auto aty = ty.getAsAggregateType();
     if (ty.isVectorType() && (aty->getChild(0).isIntType() || aty->getChild(0).isFloatType())) {
       for (unsigned I = 0; I < aty->numElementsConst(); ++I) {
@@ -140,22 +224,29 @@ AliveEngine::find_model(Transform &t,
   auto [poison_cnstr, value_cnstr] = ty.refines(src_state, tgt_state, sv.val, tv.val);
   expr dom = dom_a && dom_b;
 
-/*  auto src_mem = src_state.returnMemory();
-  auto tgt_mem = tgt_state.returnMemory();
-  auto [memory_cnstr0, ptr_refinement0, mem_undef]
-    = src_mem.refined(tgt_mem, false);
-  qvars.insert(mem_undef.begin(), mem_undef.end());*/
+  expr memory_cnstr(true);
+  if (CheckMemory) {
+    auto src_mem = src_state.returnMemory();
+    auto tgt_mem = tgt_state.returnMemory();
+    auto [memory_cnstr0, ptr_refinement0, mem_undef]
+      = src_mem.refined(tgt_mem, false);
+    qvars.insert(mem_undef.begin(), mem_undef.end());
+    memory_cnstr = std::move(memory_cnstr0);
+  }
 
   // TODO: dom check seems redundant
-  // TODO: add memory back here
-  auto r = check_expr(mk_fml(poison_cnstr && value_cnstr), "minotaur");
+  auto r = check_expr(holes &&
+                      mk_fml(poison_cnstr && value_cnstr && memory_cnstr),
+                      "minotaur");
 
   if (r.isInvalid()) {
+    Refuted = true;
     errs.add("Invalid expr", false);
     return errs;
   }
 
   if (r.isTimeout()) {
+    TimedOut = true;
     errs.add("Timeout", false);
     return errs;
   }
@@ -171,6 +262,7 @@ AliveEngine::find_model(Transform &t,
   }
 
   if (r.isUnsat()) {
+    Refuted = true;
     errs.add("Unsat", false);
     return errs;
   }
@@ -215,13 +307,73 @@ static const llvm::fltSemantics &getFloatSemantics(unsigned BitWidth) {
   }
 }
 
+// the reserved constants of tgt, in argument order
+static vector<Argument*> reservedConsts(llvm::Function &tgt) {
+  vector<Argument*> RCs;
+  for (auto &arg : tgt.args()) {
+    if (arg.getName().starts_with("_reservedc"))
+      RCs.push_back(&arg);
+  }
+  return RCs;
+}
+
+static bool parseConstants(llvm::Function &tgt, const vector<string> &Consts,
+   unordered_map<llvm::Argument*, llvm::Constant*>& ConstMap) {
+  auto RCs = reservedConsts(tgt);
+  if (RCs.size() != Consts.size())
+    return false;
+  for (unsigned i = 0; i < RCs.size(); ++i) {
+    SMDiagnostic Diag;
+    auto *C = parseConstantValue(Consts[i], Diag, *tgt.getParent());
+    if (!C || C->getType() != RCs[i]->getType())
+      return false;
+    ConstMap[RCs[i]] = C;
+  }
+  return true;
+}
+
 // call constant synthesizer and fill in constMap if synthesis suceeeds
 bool
 AliveEngine::constantSynthesis(llvm::Function &src, llvm::Function &tgt,
-   unordered_map<llvm::Argument*, llvm::Constant*>& ConstMap) {
-
-  std::optional<smt::smt_initializer> smt_init;
-  smt_init.emplace();
+   unordered_map<llvm::Argument*, llvm::Constant*>& ConstMap,
+   const unordered_map<const llvm::Argument*, ReservedConst*> &Holes) {
+
+  configure(true);
+  TimedOut = Refuted = Cached = false;
+
+  // the domains are part of the query
+  unordered_map<string, const Domain*> Domains;
+  string Kind = "synthesis";
+  raw_string_ostream KS(Kind);
+  unsigned N = 0;
+  for (auto *A : reservedConsts(tgt)) {
+    auto It = Holes.find(A);
+    ++N;
+    if (It == Holes.end() || It->second->getDomain().K == Domain::Any)
+      continue;
+    auto &D = It->second->getDomain();
+    Domains["%" + A->getName().str()] = &D;
+    KS << " " << N - 1 << ":";
+    D.print(KS);
+  }
+  KS.flush();
+
+  string Key;
+  if (querycache::enabled()) {
+    Key = querycache::key(Kind, src, tgt);
+    if (auto E = querycache::lookup(Key, Timeout)) {
+      if (E->V != querycache::Valid) {
+        Cached = true;
+        TimedOut = E->V == querycache::Timeout;
+        return false;
+      }
+      if (parseConstants(tgt, E->Constants, ConstMap)) {
+        Cached = true;
+        return true;
+      }
+      ConstMap.clear();
+    }
+  }
 
   auto Func1 = llvm_util::llvm2alive(src, TLI.getTLI(src), true);
   auto Func2 = llvm_util::llvm2alive(tgt, TLI.getTLI(tgt), true);
@@ -252,13 +404,21 @@ AliveEngine::constantSynthesis(llvm::Function &src, llvm::Function &tgt,
     }
   }
 
+  bool CheckMemory = false;
+  for (auto &BB : src)
+    for (auto &I : BB)
+      CheckMemory |= I.mayReadOrWriteMemory();
+
   // assume type verifies
   std::unordered_map<const IR::Value*, smt::expr> result;
-  Errors errs = find_model(t, result);
+  Errors errs = find_model(t, result, CheckMemory, Domains);
 
   bool ret(errs);
   if (ret) {
     *debug << "unable to find constants: \n" << errs;
+    if (!Key.empty() && (Refuted || TimedOut))
+      querycache::store(Key, {Refuted ? querycache::Invalid :
+                              querycache::Timeout, Timeout, {}});
     return false;
   }
 
@@ -302,6 +462,20 @@ AliveEngine::constantSynthesis(llvm::Function &src, llvm::Function &tgt,
       UNREACHABLE();
     }
   }
+
+  if (!Key.empty()) {
+    querycache::Entry E{querycache::Valid, Timeout, {}};
+    for (auto *A : reservedConsts(tgt)) {
+      auto It = ConstMap.find(A);
+      if (It == ConstMap.end())
+        return true;
+      string S;
+      raw_string_ostream OS(S);
+      It->second->printAsOperand(OS, /*PrintType=*/true);
+      E.Constants.push_back(OS.str());
+    }
+    querycache::store(Key, E);
+  }
   return true;
 }
 } // namespace minotaur
@@ -0,0 +1,170 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "concrete.h"
+
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include <algorithm>
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+Constant *scalarInput(Type *Ty, unsigned Lane, unsigned Round,
+                      mt19937_64 &R) {
+  unsigned Bits = Ty->getPrimitiveSizeInBits().getFixedValue();
+  if (Round == 0) {
+    if (Ty->isIntegerTy())
+      return ConstantInt::get(Ty, Lane + 1);
+    return ConstantFP::get(Ty, double(Lane + 1));
+  }
+
+  SmallVector<uint64_t, 2> Words((Bits + 63) / 64);
+  for (auto &W : Words)
+    W = R();
+  APInt V(Bits, Words);
+  if (Ty->isIntegerTy())
+    return ConstantInt::get(Ty, V);
+  return ConstantFP::get(Ty->getContext(),
+                         APFloat(Ty->getFltSemantics(), V));
+}
+
+// the x86 shifts by an immediate, which llvm does not constant fold. A
+// shift by the width or more clears the lanes, or fills them with the sign.
+Constant *foldShiftImm(CallInst &CI, ArrayRef<Constant*> Ops) {
+  auto *Callee = CI.getCalledFunction();
+  auto *VT = dyn_cast<FixedVectorType>(CI.getType());
+  if (!Callee || !VT || !Callee->getName().starts_with("llvm.x86."))
+    return nullptr;
+  StringRef Name = Callee->getName();
+  Instruction::BinaryOps Op;
+  if (Name.contains(".pslli."))
+    Op = Instruction::Shl;
+  else if (Name.contains(".psrli."))
+    Op = Instruction::LShr;
+  else if (Name.contains(".psrai."))
+    Op = Instruction::AShr;
+  else
+    return nullptr;
+
+  auto *Amt = dyn_cast<ConstantInt>(Ops[1]);
+  if (!Amt)
+    return nullptr;
+  unsigned Bits = VT->getScalarSizeInBits();
+  unsigned N = Amt->getValue().getLimitedValue(Bits);
+
+  SmallVector<Constant*, 16> Elts;
+  for (unsigned i = 0; i < VT->getNumElements(); ++i) {
+    auto *E = dyn_cast_or_null<ConstantInt>(Ops[0]->getAggregateElement(i));
+    if (!E)
+      return nullptr;
+    APInt V = E->getValue();
+    if (Op == Instruction::AShr)
+      V = V.ashr(std::min(N, Bits - 1));
+    else if (N == Bits)
+      V = APInt::getZero(Bits);
+    else
+      V = Op == Instruction::Shl ? V.shl(N) : V.lshr(N);
+    Elts.push_back(ConstantInt::get(VT->getElementType(), V));
+  }
+  return ConstantVector::get(Elts);
+}
+
+}
+
+namespace minotaur {
+
+Constant *evaluate(Function &F, ArrayRef<Constant*> Args) {
+  if (F.arg_size() != Args.size())
+    return nullptr;
+  // straight-line slices end with the unreachable sink block of the slicer
+  for (auto &BB : F) {
+    if (&BB != &F.getEntryBlock() &&
+        !(pred_empty(&BB) && isa<UnreachableInst>(BB.front())))
+      return nullptr;
+  }
+
+  auto &DL = F.getParent()->getDataLayout();
+  DenseMap<llvm::Value*, Constant*> Vals;
+  for (auto [A, C] : zip(F.args(), Args))
+    Vals[&A] = C;
+
+  auto get = [&](llvm::Value *V) -> Constant* {
+    if (auto *C = dyn_cast<Constant>(V))
+      return C;
+    return Vals.lookup(V);
+  };
+
+  for (auto &I : F.getEntryBlock()) {
+    if (auto *RI = dyn_cast<ReturnInst>(&I))
+      return RI->getReturnValue() ? get(RI->getReturnValue()) : nullptr;
+    if (I.getType()->isVoidTy() || I.mayReadOrWriteMemory())
+      return nullptr;
+
+    SmallVector<Constant*, 4> Ops;
+    for (auto &Op : I.operands()) {
+      auto *C = get(Op);
+      if (!C)
+        return nullptr;
+      Ops.push_back(C);
+    }
+    // calls fold through ConstantFoldCall, with the callee as last operand
+    auto *CI = dyn_cast<CallInst>(&I);
+    auto *C = CI ? foldShiftImm(*CI, Ops) : nullptr;
+    if (!C)
+      C = ConstantFoldInstOperands(&I, Ops, DL);
+    if (!C)
+      return nullptr;
+    Vals[&I] = C;
+  }
+  return nullptr;
+}
+
+Constant *testInput(Type *Ty, unsigned Round, mt19937_64 &R) {
+  auto *VT = dyn_cast<FixedVectorType>(Ty);
+  Type *ETy = VT ? VT->getElementType() : Ty;
+  if (!ETy->isIntegerTy() && !ETy->isIEEELikeFPTy())
+    return nullptr;
+  if (!VT)
+    return scalarInput(Ty, 0, Round, R);
+
+  SmallVector<Constant*, 16> Elts;
+  for (unsigned i = 0; i < VT->getNumElements(); ++i)
+    Elts.push_back(scalarInput(ETy, i, Round, R));
+  return ConstantVector::get(Elts);
+}
+
+bool differs(Constant *Src, Constant *Tgt) {
+  // poison and undef in src are refined by anything
+  if (isa<UndefValue>(Src))
+    return false;
+
+  if (auto *VT = dyn_cast<FixedVectorType>(Src->getType())) {
+    for (unsigned i = 0; i < VT->getNumElements(); ++i) {
+      auto *S = Src->getAggregateElement(i);
+      auto *T = Tgt->getAggregateElement(i);
+      if (S && T && differs(S, T))
+        return true;
+    }
+    return false;
+  }
+
+  // NaN payloads are not fixed
+  if (auto *FP = dyn_cast<ConstantFP>(Src); FP && FP->isNaN())
+    return false;
+  if (!isa<ConstantInt, ConstantFP>(Src) ||
+      !isa<ConstantInt, ConstantFP, UndefValue>(Tgt))
+    return false;
+  return Src != Tgt;
+}
+
+}
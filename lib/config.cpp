@@ -27,7 +27,16 @@ bool disable_avx512 = true;
 bool show_stats = false;
 bool return_first_solution = false;
 
-unsigned slice_to;
+double slice_to;
+unsigned query_to = 60000;
+unsigned query_fast_to = 0;
+unsigned smt_seed = 0;
+std::string smt_cache_dir;
+unsigned reduced_lanes = 0;
+bool generalize = false;
+bool egraph = false;
+std::string rank_model;
+std::string cost_table;
 unsigned slicer_max_depth = 5;
 
 
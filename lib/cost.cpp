@@ -1,21 +1,26 @@
 // Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
 // Distributed under the MIT license that can be found in the LICENSE file.
 #include "cost.h"
+#include "config.h"
 #include "utils.h"
 #include "cost-command.h"
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 
 #include <fstream>
 #include <map>
+#include <memory>
+#include <unordered_map>
 
 using namespace llvm;
 using namespace std;
@@ -94,10 +99,97 @@ unsigned get_machine_cost(Function *F) {
   return cycle;
 }
 
+string get_cost_key(Instruction &I) {
+  if (isa<ReturnInst, UnreachableInst>(&I))
+    return "";
+
+  string Op = I.getOpcodeName();
+  if (auto *CI = dyn_cast<CallInst>(&I)) {
+    auto *Callee = CI->getCalledFunction();
+    if (Callee && Callee->getName().starts_with("__fksv"))
+      Op = "shufflevector";
+    else if (Callee && Callee->isIntrinsic())
+      Op = Callee->isTargetIntrinsic() ?
+        Callee->getName().drop_front(5).str() :
+        Intrinsic::getBaseName(Callee->getIntrinsicID()).drop_front(5).str();
+  }
+
+  // comparisons by the width of what they compare
+  Type *Ty = isa<CmpInst>(&I) ? I.getOperand(0)->getType() : I.getType();
+  unsigned Width = Ty->getScalarSizeInBits();
+  if (auto *VT = dyn_cast<FixedVectorType>(Ty))
+    Width *= VT->getNumElements();
+  return Op + "." + to_string(Width);
+}
+
+namespace {
+
+// weights by cost key, fitted by minotaur-calibrate
+class CostTable {
+  unordered_map<string, unsigned> Weights;
+  // the weight of the keys the table does not have
+  unsigned Default = 2;
+
+public:
+  bool load(StringRef Path);
+  unsigned weight(Instruction &I) const {
+    auto Key = get_cost_key(I);
+    if (Key.empty())
+      return 0;
+    auto It = Weights.find(Key);
+    return It == Weights.end() ? Default : It->second;
+  }
+};
+
+// one weight per line, "<key> <weight>", and "* <weight>" for the others
+bool CostTable::load(StringRef Path) {
+  auto Buf = MemoryBuffer::getFile(Path);
+  if (!Buf)
+    return false;
+
+  SmallVector<StringRef, 0> Lines;
+  (*Buf)->getBuffer().split(Lines, '\n', -1, false);
+  bool Any = false;
+  for (auto Line : Lines) {
+    if (Line.starts_with("#"))
+      continue;
+    auto [Key, Weight] = Line.split(' ');
+    unsigned W;
+    if (Weight.trim().getAsInteger(10, W))
+      return false;
+    if (Key == "*")
+      Default = W;
+    else
+      Weights[Key.str()] = W;
+    Any = true;
+  }
+  return Any;
+}
+
+const CostTable *costTable() {
+  static unique_ptr<CostTable> Table = [] {
+    if (config::cost_table.empty())
+      return unique_ptr<CostTable>();
+    auto T = make_unique<CostTable>();
+    if (!T->load(config::cost_table))
+      report_fatal_error((StringRef)"[cost] cannot load the cost table " +
+                         config::cost_table);
+    return T;
+  }();
+  return Table.get();
+}
+
+}
+
 unsigned get_approx_cost(llvm::Function *F) {
+  auto *Table = costTable();
   unsigned cost = 0;
   for (auto &BB : *F) {
     for (auto &I : BB) {
+      if (Table) {
+        cost += Table->weight(I);
+        continue;
+      }
       if (isa<Argument>(&I)) {
         cost += 1;
         // reserved const
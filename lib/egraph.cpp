@@ -0,0 +1,909 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "egraph.h"
+#include "codegen.h"
+#include "config.h"
+#include "cost.h"
+#include "parse.h"
+#include "stats.h"
+#include "utils.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_set>
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+struct debug {
+template<class T>
+debug &operator<<(const T &s)
+{
+if (minotaur::config::debug_enumerator)
+  minotaur::config::dbg() << s;
+return *this;
+}
+};
+
+using minotaur::Inst;
+using minotaur::type;
+using minotaur::BinaryOp;
+using minotaur::UnaryOp;
+using minotaur::ICmp;
+using minotaur::FCmp;
+using minotaur::SIMDBinOpInst;
+using minotaur::FakeShuffleInst;
+using minotaur::ExtractElement;
+using minotaur::InsertElement;
+using minotaur::IntConversion;
+using minotaur::FPConversion;
+using minotaur::Select;
+using minotaur::ReservedConst;
+using minotaur::Copy;
+using minotaur::Var;
+using Term = minotaur::Value;
+using Owner = vector<unique_ptr<Inst>>;
+
+// budget of a saturation
+constexpr unsigned MaxIterations = 8;
+constexpr unsigned MaxNodes = 4096;
+constexpr unsigned MaxMatches = 16;
+// rules kept in memory
+constexpr unsigned MaxRules = 1024;
+
+template<class T>
+T *own(Owner &O, unique_ptr<T> I) {
+  T *P = I.get();
+  O.emplace_back(std::move(I));
+  return P;
+}
+
+string constText(Constant *C) {
+  string S;
+  raw_string_ostream OS(S);
+  C->print(OS);
+  return S;
+}
+
+// the same constant in the context of M, rules live in their own context
+Constant *localize(Constant *C, Module &M) {
+  if (&C->getContext() == &M.getContext())
+    return C;
+  SMDiagnostic Err;
+  return parseConstantValue(constText(C), Err, M);
+}
+
+bool isPatternVar(Inst *I) {
+  auto *V = dynamic_cast<Var*>(I);
+  return V && isa<Argument>(V->V());
+}
+
+// the operation of I without its operands, the reserved constants of
+// shuffles and element accesses are part of the operation
+string opKey(Inst *I) {
+  string S;
+  raw_string_ostream OS(S);
+  if (auto *V = dynamic_cast<Var*>(I)) {
+    OS << "var " << V->getName() << " " << (const void*)V->V();
+  } else if (auto *RC = dynamic_cast<ReservedConst*>(I)) {
+    OS << "const " << (RC->getC() ? constText(RC->getC()) : "null");
+  } else if (auto *CP = dynamic_cast<Copy*>(I)) {
+    OS << "copy " << (CP->V()->getC() ? constText(CP->V()->getC()) : "null");
+  } else if (auto *U = dynamic_cast<UnaryOp*>(I)) {
+    OS << "unary " << U->K() << " " << U->getWorkTy();
+  } else if (auto *B = dynamic_cast<BinaryOp*>(I)) {
+    OS << "binary " << B->K() << " " << B->getWorkTy();
+  } else if (auto *C = dynamic_cast<ICmp*>(I)) {
+    OS << "icmp " << C->K() << " " << C->getLanes();
+  } else if (auto *C = dynamic_cast<FCmp*>(I)) {
+    OS << "fcmp " << C->K() << " " << C->getLanes();
+  } else if (auto *X = dynamic_cast<SIMDBinOpInst*>(I)) {
+    OS << "x86 " << (unsigned)X->K();
+  } else if (auto *SV = dynamic_cast<FakeShuffleInst*>(I)) {
+    OS << "shuffle " << SV->getRetTy() << " " << (SV->R() ? 2 : 1) << " "
+       << constText(SV->M()->getC());
+  } else if (auto *EE = dynamic_cast<ExtractElement*>(I)) {
+    OS << "extract " << EE->getType() << " " << constText(EE->Idx()->getC());
+  } else if (auto *IE = dynamic_cast<InsertElement*>(I)) {
+    OS << "insert " << IE->getType() << " " << constText(IE->Idx()->getC());
+  } else if (auto *IC = dynamic_cast<IntConversion*>(I)) {
+    OS << "iconv " << IC->K() << " " << IC->getPrevTy() << " "
+       << IC->getNewTy();
+  } else if (auto *FC = dynamic_cast<FPConversion*>(I)) {
+    OS << "fpconv " << FC->K() << " " << FC->getType();
+  } else if (dynamic_cast<Select*>(I)) {
+    OS << "select";
+  }
+  return S;
+}
+
+SmallVector<Term*, 3> operands(Inst *I) {
+  if (auto *U = dynamic_cast<UnaryOp*>(I))
+    return {U->V()};
+  if (auto *B = dynamic_cast<BinaryOp*>(I))
+    return {B->L(), B->R()};
+  if (auto *C = dynamic_cast<ICmp*>(I))
+    return {C->L(), C->R()};
+  if (auto *C = dynamic_cast<FCmp*>(I))
+    return {C->L(), C->R()};
+  if (auto *X = dynamic_cast<SIMDBinOpInst*>(I))
+    return {X->L(), X->R()};
+  if (auto *SV = dynamic_cast<FakeShuffleInst*>(I)) {
+    if (SV->R())
+      return {SV->L(), SV->R()};
+    return {SV->L()};
+  }
+  if (auto *EE = dynamic_cast<ExtractElement*>(I))
+    return {EE->V()};
+  if (auto *IE = dynamic_cast<InsertElement*>(I))
+    return {IE->V(), IE->Elt()};
+  if (auto *IC = dynamic_cast<IntConversion*>(I))
+    return {IC->V()};
+  if (auto *FC = dynamic_cast<FPConversion*>(I))
+    return {FC->V()};
+  if (auto *S = dynamic_cast<Select*>(I))
+    return {S->Cond(), S->L(), S->R()};
+  return {};
+}
+
+// I over other operands, with its constants in the context of M
+Term *rebuild(Inst *I, ArrayRef<Term*> Ops, Module &M, Owner &O) {
+  auto rc = [&](ReservedConst *RC) {
+    auto *C = localize(RC->getC(), M);
+    return own(O, make_unique<ReservedConst>(type(C->getType()), C));
+  };
+
+  if (auto *V = dynamic_cast<Var*>(I))
+    return V;
+  if (auto *RC = dynamic_cast<ReservedConst*>(I))
+    return &RC->getC()->getContext() == &M.getContext() ? RC : rc(RC);
+  if (auto *CP = dynamic_cast<Copy*>(I))
+    return own(O, make_unique<Copy>(*rc(CP->V())));
+  if (auto *U = dynamic_cast<UnaryOp*>(I)) {
+    type W = U->getWorkTy();
+    return own(O, make_unique<UnaryOp>(U->K(), *Ops[0], W));
+  }
+  if (auto *B = dynamic_cast<BinaryOp*>(I)) {
+    type W = B->getWorkTy();
+    return own(O, make_unique<BinaryOp>(B->K(), *Ops[0], *Ops[1], W));
+  }
+  if (auto *C = dynamic_cast<ICmp*>(I))
+    return own(O, make_unique<ICmp>(C->K(), *Ops[0], *Ops[1], C->getLanes()));
+  if (auto *C = dynamic_cast<FCmp*>(I))
+    return own(O, make_unique<FCmp>(C->K(), *Ops[0], *Ops[1], C->getLanes()));
+  if (auto *X = dynamic_cast<SIMDBinOpInst*>(I))
+    return own(O, make_unique<SIMDBinOpInst>(X->K(), *Ops[0], *Ops[1]));
+  if (auto *SV = dynamic_cast<FakeShuffleInst*>(I)) {
+    type Ty = SV->getRetTy();
+    return own(O, make_unique<FakeShuffleInst>(
+        *Ops[0], Ops.size() > 1 ? Ops[1] : nullptr, *rc(SV->M()), Ty));
+  }
+  if (auto *EE = dynamic_cast<ExtractElement*>(I)) {
+    type Ty = EE->getType();
+    return own(O, make_unique<ExtractElement>(*Ops[0], *rc(EE->Idx()), Ty));
+  }
+  if (auto *IE = dynamic_cast<InsertElement*>(I)) {
+    type Ty = IE->getType();
+    return own(O, make_unique<InsertElement>(*Ops[0], *Ops[1],
+                                             *rc(IE->Idx()), Ty));
+  }
+  if (auto *IC = dynamic_cast<IntConversion*>(I)) {
+    type Prev = IC->getPrevTy(), New = IC->getNewTy();
+    return own(O, make_unique<IntConversion>(IC->K(), *Ops[0], New.getLane(),
+                                             Prev.getBits(), New.getBits()));
+  }
+  if (auto *FC = dynamic_cast<FPConversion*>(I)) {
+    type Ty = FC->getType();
+    return own(O, make_unique<FPConversion>(FC->K(), *Ops[0], Ty));
+  }
+  if (dynamic_cast<Select*>(I))
+    return own(O, make_unique<Select>(*Ops[0], *Ops[1], *Ops[2]));
+  llvm_unreachable("unknown inst in the e-graph");
+}
+
+const Intrinsic::ID X86IDs[] = {
+#define PROCESS(NAME, A, B, C, D, E, F) Intrinsic::NAME,
+#include "ir/x86_intrinsics_binop.inc"
+#undef PROCESS
+};
+
+optional<IR::X86IntrinBinOp::Op> x86Op(Intrinsic::ID ID) {
+  for (unsigned K = 0; K < std::size(X86IDs); ++K) {
+    if (X86IDs[K] == ID)
+      return static_cast<IR::X86IntrinBinOp::Op>(K);
+  }
+  return nullopt;
+}
+
+optional<BinaryOp::Op> binaryOp(unsigned Opcode) {
+  switch (Opcode) {
+  case Instruction::And:  return BinaryOp::band;
+  case Instruction::Or:   return BinaryOp::bor;
+  case Instruction::Xor:  return BinaryOp::bxor;
+  case Instruction::LShr: return BinaryOp::lshr;
+  case Instruction::AShr: return BinaryOp::ashr;
+  case Instruction::Shl:  return BinaryOp::shl;
+  case Instruction::Add:  return BinaryOp::add;
+  case Instruction::Sub:  return BinaryOp::sub;
+  case Instruction::Mul:  return BinaryOp::mul;
+  case Instruction::SDiv: return BinaryOp::sdiv;
+  case Instruction::UDiv: return BinaryOp::udiv;
+  case Instruction::FAdd: return BinaryOp::fadd;
+  case Instruction::FSub: return BinaryOp::fsub;
+  case Instruction::FMul: return BinaryOp::fmul;
+  case Instruction::FDiv: return BinaryOp::fdiv;
+  default: return nullopt;
+  }
+}
+
+optional<BinaryOp::Op> binaryIntrinsic(Intrinsic::ID ID) {
+  switch (ID) {
+  case Intrinsic::umax:     return BinaryOp::umax;
+  case Intrinsic::umin:     return BinaryOp::umin;
+  case Intrinsic::smax:     return BinaryOp::smax;
+  case Intrinsic::smin:     return BinaryOp::smin;
+  case Intrinsic::maxnum:   return BinaryOp::fmaxnum;
+  case Intrinsic::minnum:   return BinaryOp::fminnum;
+  case Intrinsic::maximum:  return BinaryOp::fmaximum;
+  case Intrinsic::minimum:  return BinaryOp::fminimum;
+  case Intrinsic::copysign: return BinaryOp::copysign;
+  default: return nullopt;
+  }
+}
+
+optional<UnaryOp::Op> unaryIntrinsic(Intrinsic::ID ID) {
+  switch (ID) {
+  case Intrinsic::bitreverse: return UnaryOp::bitreverse;
+  case Intrinsic::bswap:      return UnaryOp::bswap;
+  case Intrinsic::ctpop:      return UnaryOp::ctpop;
+  case Intrinsic::fabs:       return UnaryOp::fabs;
+  case Intrinsic::ceil:       return UnaryOp::fceil;
+  case Intrinsic::floor:      return UnaryOp::ffloor;
+  case Intrinsic::rint:       return UnaryOp::frint;
+  case Intrinsic::nearbyint:  return UnaryOp::fnearbyint;
+  case Intrinsic::round:      return UnaryOp::fround;
+  case Intrinsic::roundeven:  return UnaryOp::froundeven;
+  case Intrinsic::trunc:      return UnaryOp::ftrunc;
+  default: return nullopt;
+  }
+}
+
+ICmp::Cond icmpCond(CmpInst::Predicate P) {
+  switch (P) {
+  case CmpInst::ICMP_EQ:  return ICmp::eq;
+  case CmpInst::ICMP_NE:  return ICmp::ne;
+  case CmpInst::ICMP_ULT: return ICmp::ult;
+  case CmpInst::ICMP_ULE: return ICmp::ule;
+  case CmpInst::ICMP_SLT: return ICmp::slt;
+  case CmpInst::ICMP_SLE: return ICmp::sle;
+  case CmpInst::ICMP_UGT: return ICmp::ugt;
+  case CmpInst::ICMP_UGE: return ICmp::uge;
+  case CmpInst::ICMP_SGT: return ICmp::sgt;
+  default:                return ICmp::sge;
+  }
+}
+
+FCmp::Cond fcmpCond(CmpInst::Predicate P) {
+  switch (P) {
+  case CmpInst::FCMP_FALSE: return FCmp::f;
+  case CmpInst::FCMP_OEQ:   return FCmp::oeq;
+  case CmpInst::FCMP_OGT:   return FCmp::ogt;
+  case CmpInst::FCMP_OGE:   return FCmp::oge;
+  case CmpInst::FCMP_OLT:   return FCmp::olt;
+  case CmpInst::FCMP_OLE:   return FCmp::ole;
+  case CmpInst::FCMP_ONE:   return FCmp::one;
+  case CmpInst::FCMP_ORD:   return FCmp::ord;
+  case CmpInst::FCMP_UEQ:   return FCmp::ueq;
+  case CmpInst::FCMP_UGT:   return FCmp::ugt;
+  case CmpInst::FCMP_UGE:   return FCmp::uge;
+  case CmpInst::FCMP_ULT:   return FCmp::ult;
+  case CmpInst::FCMP_ULE:   return FCmp::ule;
+  case CmpInst::FCMP_UNE:   return FCmp::une;
+  case CmpInst::FCMP_UNO:   return FCmp::uno;
+  default:                  return FCmp::t;
+  }
+}
+
+unsigned lanes(llvm::Type *Ty) {
+  auto *VT = dyn_cast<FixedVectorType>(Ty);
+  return VT ? VT->getNumElements() : 1;
+}
+
+// Lifts llvm values into Insts. Values the DSL cannot express, and values
+// with such operands, become vars. Poison flags are dropped, which the
+// verification of the extracted term accounts for.
+class Lifter {
+  Owner &O;
+  DenseMap<llvm::Value*, Term*> Memo;
+
+  Term *compute(llvm::Value *V);
+
+public:
+  explicit Lifter(Owner &O) : O(O) {}
+
+  Term *lift(llvm::Value *V) {
+    auto It = Memo.find(V);
+    if (It != Memo.end())
+      return It->second;
+    auto *T = compute(V);
+    Memo[V] = T;
+    return T;
+  }
+};
+
+Term *Lifter::compute(llvm::Value *V) {
+  auto *Ty = V->getType()->getScalarType();
+  if (!Ty->isIntegerTy() && !Ty->isIEEELikeFPTy())
+    return nullptr;
+  if (auto *C = dyn_cast<Constant>(V))
+    return own(O, make_unique<ReservedConst>(type(C->getType()), C));
+  auto var = [&] { return own(O, make_unique<Var>(V)); };
+  auto *I = dyn_cast<Instruction>(V);
+  if (!I)
+    return var();
+
+  SmallVector<Term*, 3> Ops;
+  unsigned NumOps = isa<CallInst>(I) ? cast<CallInst>(I)->arg_size()
+                                     : I->getNumOperands();
+  for (unsigned i = 0; i < NumOps; ++i) {
+    auto *Op = I->getOperand(i);
+    // the poison operand of a shuffle and the index of element accesses
+    // are part of the operation
+    if ((isa<ShuffleVectorInst>(I) && i == 1 && isa<UndefValue>(Op)) ||
+        (isa<ExtractElementInst>(I) && i == 1) ||
+        (isa<InsertElementInst>(I) && i == 2))
+      continue;
+    auto *T = lift(Op);
+    if (!T)
+      return var();
+    Ops.push_back(T);
+  }
+  type ResTy(I->getType());
+
+  if (auto K = binaryOp(I->getOpcode()))
+    return own(O, make_unique<BinaryOp>(*K, *Ops[0], *Ops[1], ResTy));
+  if (I->getOpcode() == Instruction::FNeg)
+    return own(O, make_unique<UnaryOp>(UnaryOp::fneg, *Ops[0], ResTy));
+  if (auto *C = dyn_cast<ICmpInst>(I))
+    return own(O, make_unique<ICmp>(icmpCond(C->getPredicate()), *Ops[0],
+                                    *Ops[1], lanes(I->getType())));
+  if (auto *C = dyn_cast<FCmpInst>(I))
+    return own(O, make_unique<FCmp>(fcmpCond(C->getPredicate()), *Ops[0],
+                                    *Ops[1], lanes(I->getType())));
+  if (isa<SelectInst>(I))
+    return own(O, make_unique<Select>(*Ops[0], *Ops[1], *Ops[2]));
+  if (isa<BitCastInst>(I))
+    return Ops[0];
+
+  if (auto *Cast = dyn_cast<CastInst>(I)) {
+    unsigned Prev = Cast->getSrcTy()->getScalarSizeInBits();
+    unsigned New = Cast->getDestTy()->getScalarSizeInBits();
+    switch (Cast->getOpcode()) {
+    case Instruction::SExt:
+      return own(O, make_unique<IntConversion>(IntConversion::sext, *Ops[0],
+                                               lanes(I->getType()), Prev, New));
+    case Instruction::ZExt:
+      return own(O, make_unique<IntConversion>(IntConversion::zext, *Ops[0],
+                                               lanes(I->getType()), Prev, New));
+    case Instruction::Trunc:
+      return own(O, make_unique<IntConversion>(IntConversion::trunc, *Ops[0],
+                                               lanes(I->getType()), Prev, New));
+    case Instruction::FPTrunc:
+      return own(O, make_unique<FPConversion>(FPConversion::fptrunc, *Ops[0],
+                                              ResTy));
+    case Instruction::FPExt:
+      return own(O, make_unique<FPConversion>(FPConversion::fpext, *Ops[0],
+                                              ResTy));
+    case Instruction::FPToUI:
+      return own(O, make_unique<FPConversion>(FPConversion::fptoui, *Ops[0],
+                                              ResTy));
+    case Instruction::FPToSI:
+      return own(O, make_unique<FPConversion>(FPConversion::fptosi, *Ops[0],
+                                              ResTy));
+    case Instruction::UIToFP:
+      return own(O, make_unique<FPConversion>(FPConversion::uitofp, *Ops[0],
+                                              ResTy));
+    case Instruction::SIToFP:
+      return own(O, make_unique<FPConversion>(FPConversion::sitofp, *Ops[0],
+                                              ResTy));
+    default:
+      return var();
+    }
+  }
+
+  if (auto *SV = dyn_cast<ShuffleVectorInst>(I)) {
+    auto *Mask = SV->getShuffleMaskForBitcode();
+    auto *RC = own(O, make_unique<ReservedConst>(type(Mask->getType()), Mask));
+    return own(O, make_unique<FakeShuffleInst>(
+        *Ops[0], Ops.size() > 1 ? Ops[1] : nullptr, *RC, ResTy));
+  }
+  if (auto *EE = dyn_cast<ExtractElementInst>(I)) {
+    auto *Idx = dyn_cast<ConstantInt>(EE->getIndexOperand());
+    if (!Idx)
+      return var();
+    auto *RC = own(O, make_unique<ReservedConst>(type(Idx->getType()), Idx));
+    return own(O, make_unique<ExtractElement>(*Ops[0], *RC, ResTy));
+  }
+  if (auto *IE = dyn_cast<InsertElementInst>(I)) {
+    auto *Idx = dyn_cast<ConstantInt>(IE->getOperand(2));
+    if (!Idx)
+      return var();
+    auto *RC = own(O, make_unique<ReservedConst>(type(Idx->getType()), Idx));
+    // an insertelement is typed by its element, as the parser does
+    type EltTy(IE->getOperand(1)->getType());
+    return own(O, make_unique<InsertElement>(*Ops[0], *Ops[1], *RC, EltTy));
+  }
+
+  if (auto *II = dyn_cast<IntrinsicInst>(I)) {
+    auto ID = II->getIntrinsicID();
+    if (auto K = binaryIntrinsic(ID))
+      return own(O, make_unique<BinaryOp>(*K, *Ops[0], *Ops[1], ResTy));
+    if (auto K = unaryIntrinsic(ID))
+      return own(O, make_unique<UnaryOp>(*K, *Ops[0], ResTy));
+    if (auto K = x86Op(ID))
+      return own(O, make_unique<SIMDBinOpInst>(*K, *Ops[0], *Ops[1]));
+  }
+  return var();
+}
+
+// the leaves of a pattern are constants and arguments, other values of the
+// slice must not leak into the e-graph of another function
+bool isPattern(Term *T) {
+  if (auto *V = dynamic_cast<Var*>(T))
+    return isPatternVar(V);
+  return all_of(operands(T), isPattern);
+}
+
+// the right hand side of a rule, with the values of the slice it refers to
+// replaced by their terms in the left hand side
+Term *substitute(Inst *I, Lifter &L, Module &M, Owner &O) {
+  if (auto *V = dynamic_cast<Var*>(I)) {
+    if (isa<Argument>(V->V()))
+      return V;
+    return L.lift(V->V());
+  }
+  SmallVector<Term*, 3> Ops;
+  for (auto *Op : operands(I)) {
+    auto *T = substitute(Op, L, M, O);
+    if (!T)
+      return nullptr;
+    Ops.push_back(T);
+  }
+  return rebuild(I, Ops, M, O);
+}
+
+struct ERule {
+  Term *LHS;
+  Term *RHS;
+};
+
+// the verified rewrites of the cache as rules, each in the module of its
+// slice
+class RuleBase {
+  LLVMContext Ctx;
+  vector<unique_ptr<Module>> Modules;
+  vector<unique_ptr<parse::Parser>> Parsers;
+  Owner O;
+  vector<ERule> Rules;
+  set<string> Known;
+  // entries of the redis list seen so far
+  unsigned Seen = 0;
+
+  void load(const string &Slice, const string &Rewrite);
+
+public:
+  void update(redisContext *c);
+  const vector<ERule> &rules() const { return Rules; }
+};
+
+void RuleBase::update(redisContext *c) {
+  vector<string> Keys;
+  hGetRules(Seen, Keys, c);
+  Seen += Keys.size();
+  for (auto &K : Keys) {
+    if (Rules.size() >= MaxRules)
+      return;
+    if (!Known.insert(sliceHash(K)).second)
+      continue;
+    string Rewrite;
+    if (!hGet(K.c_str(), K.size(), Rewrite, c) || Rewrite == "<no-sol>" ||
+        Rewrite == "<pending>")
+      continue;
+    load(K, Rewrite);
+  }
+}
+
+void RuleBase::load(const string &Slice, const string &Rewrite) {
+  SMDiagnostic Err;
+  auto M = parseAssemblyString(Slice, Err, Ctx);
+  if (!M)
+    return;
+
+  Function *F = nullptr;
+  for (auto &Fn : *M) {
+    if (Fn.isDeclaration())
+      continue;
+    if (F)
+      return;
+    F = &Fn;
+  }
+  if (!F)
+    return;
+  // straight-line slices end with the unreachable sink block of the slicer
+  for (auto &BB : *F) {
+    if (&BB != &F->getEntryBlock() &&
+        !(pred_empty(&BB) && isa<UnreachableInst>(BB.front())))
+      return;
+  }
+  auto *Ret = dyn_cast<ReturnInst>(F->getEntryBlock().getTerminator());
+  if (!Ret || !Ret->getReturnValue())
+    return;
+
+  auto P = make_unique<parse::Parser>(*F);
+  auto RHSs = P->parse(*F, Rewrite);
+  if (RHSs.empty())
+    return;
+
+  Lifter L(O);
+  auto *LHS = L.lift(Ret->getReturnValue());
+  if (!LHS || dynamic_cast<Var*>(LHS) || dynamic_cast<ReservedConst*>(LHS) ||
+      !isPattern(LHS))
+    return;
+  auto *RHS = substitute(RHSs[0].I, L, *M, O);
+  if (!RHS)
+    return;
+
+  debug() << "[egraph] rule " << *LHS << "\n"
+          << "[egraph]   => " << *RHS << "\n";
+  Rules.push_back({LHS, RHS});
+  Modules.push_back(std::move(M));
+  Parsers.push_back(std::move(P));
+}
+
+struct ENode {
+  Inst *Op;
+  string Key;
+  SmallVector<unsigned, 3> Kids;
+};
+
+// pattern variables to the classes they are bound to
+using Subst = map<llvm::Value*, unsigned>;
+
+// The weight of a node is get_approx_cost of a function that computes the
+// node alone from arguments of the types of its operands, so that the
+// e-graph weighs terms as the enumerator weighs candidates, with
+// config::cost_table if it is set.
+class NodeCost {
+  Module Scratch;
+  Owner O;
+  map<string, unsigned> Memo;
+
+public:
+  explicit NodeCost(LLVMContext &Ctx) : Scratch("", Ctx) {}
+  unsigned operator()(const ENode &N, ArrayRef<type> KidTypes);
+};
+
+unsigned NodeCost::operator()(const ENode &N, ArrayRef<type> KidTypes) {
+  // leaves are arguments and constants
+  if (dynamic_cast<Var*>(N.Op) || dynamic_cast<ReservedConst*>(N.Op) ||
+      dynamic_cast<Copy*>(N.Op))
+    return 0;
+
+  string Key = N.Key;
+  raw_string_ostream KS(Key);
+  for (auto &Ty : KidTypes)
+    KS << " " << Ty;
+  KS.flush();
+  auto It = Memo.find(Key);
+  if (It != Memo.end())
+    return It->second;
+
+  auto &Ctx = Scratch.getContext();
+  SmallVector<llvm::Type*, 3> ArgTys;
+  for (auto &Ty : KidTypes)
+    ArgTys.push_back(Ty.toLLVM(Ctx));
+  auto *RetTy = dynamic_cast<Term*>(N.Op)->getType().toLLVM(Ctx);
+  auto *Fn = Function::Create(FunctionType::get(RetTy, ArgTys, false),
+                              GlobalValue::ExternalLinkage, "node", Scratch);
+  auto *Ret = ReturnInst::Create(Ctx, PoisonValue::get(RetTy),
+                                 BasicBlock::Create(Ctx, "", Fn));
+  SmallVector<Term*, 3> Ops;
+  for (auto &A : Fn->args())
+    Ops.push_back(own(O, make_unique<Var>(&A)));
+
+  unordered_set<llvm::Function*> Decls;
+  ValueToValueMapTy VMap;
+  auto *V = minotaur::LLVMGen(Ret, Decls).codeGen(
+      rebuild(N.Op, Ops, Scratch, O), VMap);
+  Ret->setOperand(0, IRBuilder<>(Ret).CreateBitCast(V, RetTy));
+  unsigned Cost = minotaur::get_approx_cost(Fn);
+  Fn->eraseFromParent();
+  return Memo[Key] = Cost;
+}
+
+class EGraph {
+  vector<unsigned> Parent;
+  vector<vector<ENode>> Nodes;
+  vector<type> Types;
+  map<string, unsigned> Memo;
+  unsigned NumNodes = 0;
+
+  string signature(const string &Key, ArrayRef<unsigned> Kids) {
+    string S = Key + " (";
+    for (auto K : Kids)
+      S += to_string(find(K)) + " ";
+    return S + ")";
+  }
+
+  void match(Term *P, unsigned C, const Subst &S, vector<Subst> &Out);
+
+public:
+  unsigned find(unsigned C) {
+    while (Parent[C] != C)
+      C = Parent[C] = Parent[Parent[C]];
+    return C;
+  }
+
+  unsigned add(Inst *Op, SmallVector<unsigned, 3> Kids);
+  unsigned add(Term *T, const Subst &S);
+  bool merge(unsigned A, unsigned B);
+  void rebuild();
+  unsigned size() const { return NumNodes; }
+
+  void saturate(const vector<ERule> &Rules);
+  // the cost of the cheapest term of each class, and its root node
+  vector<pair<unsigned, const ENode*>> extract(NodeCost &Cost);
+};
+
+unsigned EGraph::add(Inst *Op, SmallVector<unsigned, 3> Kids) {
+  for (auto &K : Kids)
+    K = find(K);
+  string Key = opKey(Op);
+  string Sig = signature(Key, Kids);
+  auto It = Memo.find(Sig);
+  if (It != Memo.end())
+    return find(It->second);
+
+  unsigned C = Parent.size();
+  Parent.push_back(C);
+  Nodes.push_back({{Op, std::move(Key), std::move(Kids)}});
+  Types.push_back(dynamic_cast<Term*>(Op)->getType());
+  Memo[Sig] = C;
+  ++NumNodes;
+  return C;
+}
+
+unsigned EGraph::add(Term *T, const Subst &S) {
+  if (isPatternVar(T))
+    return find(S.at(static_cast<Var*>(T)->V()));
+  SmallVector<unsigned, 3> Kids;
+  for (auto *Op : operands(T))
+    Kids.push_back(add(Op, S));
+  return add(T, std::move(Kids));
+}
+
+bool EGraph::merge(unsigned A, unsigned B) {
+  A = find(A);
+  B = find(B);
+  if (A == B)
+    return false;
+  Parent[B] = A;
+  for (auto &N : Nodes[B])
+    Nodes[A].push_back(std::move(N));
+  Nodes[B].clear();
+  return true;
+}
+
+// restores the congruence: nodes with the same operation over the same
+// classes are in the same class
+void EGraph::rebuild() {
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    Memo.clear();
+    vector<pair<unsigned, unsigned>> Merges;
+    for (unsigned C = 0; C < Nodes.size(); ++C) {
+      if (find(C) != C)
+        continue;
+      for (auto &N : Nodes[C]) {
+        auto [It, New] = Memo.try_emplace(signature(N.Key, N.Kids), C);
+        if (!New && find(It->second) != C)
+          Merges.push_back({It->second, C});
+      }
+    }
+    for (auto [A, B] : Merges)
+      Changed |= merge(A, B);
+  }
+
+  // duplicates within a class
+  NumNodes = 0;
+  for (unsigned C = 0; C < Nodes.size(); ++C) {
+    if (find(C) != C)
+      continue;
+    set<string> Sigs;
+    vector<ENode> Unique;
+    for (auto &N : Nodes[C]) {
+      for (auto &K : N.Kids)
+        K = find(K);
+      if (Sigs.insert(signature(N.Key, N.Kids)).second)
+        Unique.push_back(std::move(N));
+    }
+    Nodes[C] = std::move(Unique);
+    NumNodes += Nodes[C].size();
+  }
+}
+
+void EGraph::match(Term *P, unsigned C, const Subst &S, vector<Subst> &Out) {
+  C = find(C);
+  if (isPatternVar(P)) {
+    auto *A = static_cast<Var*>(P)->V();
+    if (!Types[C].same_width(P->getType()))
+      return;
+    auto It = S.find(A);
+    if (It == S.end()) {
+      Subst S2(S);
+      S2[A] = C;
+      Out.push_back(std::move(S2));
+    } else if (find(It->second) == C) {
+      Out.push_back(S);
+    }
+    return;
+  }
+
+  string Key = opKey(P);
+  auto Ops = operands(P);
+  for (auto &N : Nodes[C]) {
+    if (N.Key != Key || N.Kids.size() != Ops.size())
+      continue;
+    vector<Subst> Cur{S};
+    for (unsigned i = 0; i < Ops.size() && !Cur.empty(); ++i) {
+      vector<Subst> Next;
+      for (auto &S2 : Cur)
+        match(Ops[i], N.Kids[i], S2, Next);
+      Cur = std::move(Next);
+    }
+    for (auto &S2 : Cur) {
+      if (Out.size() >= MaxMatches)
+        return;
+      Out.push_back(std::move(S2));
+    }
+  }
+}
+
+void EGraph::saturate(const vector<ERule> &Rules) {
+  for (unsigned Iter = 0; Iter < MaxIterations; ++Iter) {
+    // match everything first, the e-graph changes as the rules apply
+    vector<pair<unsigned, pair<const ERule*, Subst>>> Matches;
+    // commutativity is built in, the cache holds no rewrite for it
+    vector<pair<unsigned, ENode>> Commuted;
+    for (unsigned C = 0; C < Nodes.size(); ++C) {
+      if (find(C) != C)
+        continue;
+      for (auto &R : Rules) {
+        vector<Subst> Ms;
+        match(R.LHS, C, {}, Ms);
+        for (auto &S : Ms)
+          Matches.push_back({C, {&R, std::move(S)}});
+      }
+      for (auto &N : Nodes[C]) {
+        auto *B = dynamic_cast<BinaryOp*>(N.Op);
+        if (B && BinaryOp::isCommutative(B->K()))
+          Commuted.push_back({C, {N.Op, N.Key, {N.Kids[1], N.Kids[0]}}});
+      }
+    }
+
+    unsigned Before = size();
+    bool Changed = false;
+    for (auto &[C, N] : Commuted)
+      Changed |= merge(C, add(N.Op, N.Kids));
+    for (auto &[C, M] : Matches)
+      Changed |= merge(C, add(M.first->RHS, M.second));
+    rebuild();
+
+    debug() << "[egraph] iteration " << Iter << ": " << Matches.size()
+            << " matches, " << size() << " nodes\n";
+    if ((!Changed && size() == Before) || size() > MaxNodes)
+      return;
+  }
+}
+
+vector<pair<unsigned, const ENode*>> EGraph::extract(NodeCost &NC) {
+  constexpr unsigned Inf = ~0u;
+  vector<pair<unsigned, const ENode*>> Best(Nodes.size(), {Inf, nullptr});
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (unsigned C = 0; C < Nodes.size(); ++C) {
+      if (find(C) != C)
+        continue;
+      for (auto &N : Nodes[C]) {
+        SmallVector<type, 3> KidTypes;
+        for (auto K : N.Kids)
+          KidTypes.push_back(Types[find(K)]);
+        unsigned Cost = NC(N, KidTypes);
+        for (auto K : N.Kids) {
+          unsigned KC = Best[find(K)].first;
+          Cost = KC == Inf ? Inf : Cost + KC;
+          if (Cost == Inf)
+            break;
+        }
+        if (Cost < Best[C].first) {
+          Best[C] = {Cost, &N};
+          Changed = true;
+        }
+      }
+    }
+  }
+  return Best;
+}
+
+Term *build(EGraph &G, const vector<pair<unsigned, const ENode*>> &Best,
+            unsigned C, Module &M, Owner &O) {
+  auto *N = Best[G.find(C)].second;
+  SmallVector<Term*, 3> Ops;
+  for (auto K : N->Kids)
+    Ops.push_back(build(G, Best, K, M, O));
+  return rebuild(N->Op, Ops, M, O);
+}
+
+}
+
+namespace minotaur {
+
+vector<Rewrite> solveBySaturation(Enumerator &EN, Function &F, Instruction *I,
+                                  redisContext *c) {
+  if (!config::egraph || !c)
+    return {};
+
+  static RuleBase Rules;
+  Rules.update(c);
+  if (Rules.rules().empty())
+    return {};
+
+  Owner O;
+  Lifter L(O);
+  auto *T = L.lift(I);
+  if (!T || dynamic_cast<Var*>(T))
+    return {};
+
+  EGraph G;
+  unsigned Root = G.add(T, Subst());
+  G.saturate(Rules.rules());
+  NodeCost NC(F.getContext());
+  auto Best = G.extract(NC);
+  unsigned Cost = Best[G.find(Root)].first;
+  unsigned Before = get_approx_cost(&F);
+  debug() << "[egraph] " << G.size() << " nodes, cost " << Before << " -> "
+          << Cost << "\n";
+  if (Cost >= Before)
+    return {};
+
+  auto *E = build(G, Best, Root, *F.getParent(), O);
+  debug() << "[egraph] extracted " << *E << "\n";
+  vector<Sketch> Sketches{{E, {}}};
+  auto RHSs = EN.verify(F, I, Sketches, std::move(O));
+  if (!RHSs.empty())
+    stats::count(stats::Saturated);
+  return RHSs;
+}
+
+}
@@ -5,7 +5,13 @@
 #include "enumerator.h"
 #include "expr.h"
 #include "codegen.h"
+#include "concrete.h"
 #include "cost.h"
+#include "lane-reduce.h"
+#include "ranking.h"
+#include "shuffle-solver.h"
+#include "stats.h"
+#include "trace.h"
 #include "utils.h"
 #include "type.h"
 
@@ -21,6 +27,7 @@
 #include "llvm_util/llvm2alive.h"
 #include "llvm_util/utils.h"
 
+#include "llvm/ADT/ScopeExit.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/CGSCCPassManager.h"
 #include "llvm/Analysis/LoopAnalysisManager.h"
@@ -41,9 +48,12 @@
 #include "llvm/Transforms/Utils/Cloning.h"
 
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <queue>
+#include <random>
 #include <vector>
 #include <set>
 #include <map>
@@ -72,6 +82,9 @@ void Enumerator::findInputs(llvm::Function &F,
                             llvm::Instruction *root,
                             llvm::DominatorTree &DT) {
   for (auto &A : F.args()) {
+    // pointers are only there for the loads of the slice
+    if (A.getType()->isPtrOrPtrVectorTy())
+      continue;
     auto T = make_unique<Var>(&A);
     values.emplace_back(T.get());
     exprs.emplace_back(std::move(T));
@@ -95,6 +108,31 @@ void Enumerator::findInputs(llvm::Function &F,
   }
 }
 
+static llvm::StringRef intrinsicName(X86IntrinBinOp::Op K) {
+  switch (K) {
+#define PROCESS(NAME, A, B, C, D, E, F)                                        \
+  case X86IntrinBinOp::NAME:                                                   \
+    return #NAME;
+#include "ir/x86_intrinsics_binop.inc"
+#undef PROCESS
+  }
+  return "";
+}
+
+// the domain of the shift amount of a shift intrinsic, amounts past the
+// element width give the same result as the width itself
+static Domain shiftAmountDomain(X86IntrinBinOp::Op K) {
+  auto Name = intrinsicName(K);
+  unsigned Bits = getIntrinsicOp0Ty(K).getBits();
+  if (Name.contains("_psrli_") || Name.contains("_pslli_") ||
+      Name.contains("_psrai_"))
+    return Domain::range(0, Bits + 1);
+  if (Name.contains("_psrlv_") || Name.contains("_psllv_") ||
+      Name.contains("_psrav_"))
+    return Domain::lanes(0, Bits + 1);
+  return Domain();
+}
+
 bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
   vector<Value*> Comps;
   for (auto &I : values) {
@@ -239,6 +277,7 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
     RCs.insert(T.get());
     exprs.emplace_back(std::move(T));
     auto EE = make_unique<ExtractElement>(*Op0, *idx, ety);
+    idx->setDomain(Domain::range(0, EE->getInputTy().getLane()));
     sketches.push_back(make_pair(EE.get(), std::move(RCs)));
     exprs.emplace_back(std::move(EE));
   }
@@ -290,6 +329,12 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
                 continue;
               I = L;
               auto T = make_unique<ReservedConst>(workty);
+              // shift amounts past the width give poison
+              if (Op == BinaryOp::shl || Op == BinaryOp::lshr ||
+                  Op == BinaryOp::ashr)
+                T->setDomain(workty.getLane() == 1 ?
+                             Domain::range(0, workty.getBits()) :
+                             Domain::lanes(0, workty.getBits()));
               J = T.get();
               RCs.insert(T.get());
               exprs.emplace_back(std::move(T));
@@ -446,6 +491,7 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
           RCs.insert(T2.get());
           exprs.emplace_back(std::move(T2));
           auto IE = make_unique<InsertElement>(*V, *Elm, *idx, ty);
+          idx->setDomain(Domain::range(0, IE->getInputTy().getLane()));
           sketches.push_back(make_pair(IE.get(), std::move(RCs)));
           exprs.emplace_back(std::move(IE));
         }
@@ -488,6 +534,7 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
         RCs.insert(T.get());
         exprs.emplace_back(std::move(T));
         auto IE = make_unique<InsertElement>(*V, *Elm, *idx, elm_ty);
+        idx->setDomain(Domain::range(0, IE->getInputTy().getLane()));
         sketches.push_back(make_pair(IE.get(), std::move(RCs)));
         exprs.emplace_back(std::move(IE));
       }
@@ -538,6 +585,7 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
           J = R;
         } else if (dynamic_cast<ReservedConst *>(*Op1)) {
           auto T = make_unique<ReservedConst>(op1_ty);
+          T->setDomain(shiftAmountDomain(op));
           J = T.get();
           RCs.insert(T.get());
           exprs.emplace_back(std::move(T));
@@ -579,6 +627,9 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
         auto m = make_unique<ReservedConst>(mask_ty);
         RCs.insert(m.get());
         auto sv = make_unique<FakeShuffleInst>(**Op0, nullptr, *m.get(), ty);
+        // lanes of the poison operand are no better than any lane of the
+        // first, which refines them
+        m->setDomain(Domain::lanes(0, sv->getInputTy().getLane()));
         exprs.emplace_back(std::move(m));
         sketches.push_back(make_pair(sv.get(), std::move(RCs)));
         exprs.emplace_back(std::move(sv));
@@ -603,6 +654,7 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
         auto m = make_unique<ReservedConst>(mask_ty);
         RCs.insert(m.get());
         auto sv2 = make_unique<FakeShuffleInst>(**Op0, J, *m.get(), ty);
+        m->setDomain(Domain::lanes(0, 2 * sv2->getInputTy().getLane()));
         exprs.emplace_back(std::move(m));
         sketches.push_back(make_pair(sv2.get(), std::move(RCs)));
         exprs.emplace_back(std::move(sv2));
@@ -680,37 +732,197 @@ using Candidate = tuple<llvm::Function*, llvm::Function*, Inst*,
                         unordered_map<const llvm::Argument*, ReservedConst*>,
                         bool>;
 
-static bool approx(const Candidate &f1, const Candidate &f2){
-  return get_approx_cost(get<0>(f1)) < get_approx_cost(get<0>(f2));
+// by approximate cost, and among candidates of the same cost by the score
+// of their sketch under the ranking model
+static void approx(vector<Candidate> &Fns, llvm::Function &F) {
+  unordered_map<llvm::Function*, unsigned> Costs;
+  unordered_map<llvm::Function*, double> Scores;
+  auto *Model = rankModel();
+  auto Features = Model ? sliceFeatures(F) : vector<string>();
+  for (auto &C : Fns) {
+    Costs[get<0>(C)] = get_approx_cost(get<0>(C));
+    if (Model)
+      Scores[get<0>(C)] = Model->score(Features, sketchFamilies(get<2>(C)));
+  }
+  std::stable_sort(Fns.begin(), Fns.end(),
+                   [&](const Candidate &f1, const Candidate &f2) {
+    auto *T1 = get<0>(f1), *T2 = get<0>(f2);
+    if (Costs[T1] != Costs[T2])
+      return Costs[T1] < Costs[T2];
+    return Scores[T1] > Scores[T2];
+  });
 }
 
-vector<Rewrite> Enumerator::solve(llvm::Function &F, llvm::Instruction *I) {
-  unsigned CANDIDATES = 0, PRUNED = 0, GOOD = 0;
-  vector<Rewrite> ret;
+// rewrite fksv calls to shufflevector, once their masks are constants
+static void lowerFakeShuffles(llvm::Function &Tgt) {
+  for (auto &BB : Tgt) {
+    for (auto &I : make_early_inc_range(BB)) {
+      if (!isa<llvm::CallInst>(&I))
+        continue;
+      auto CI = llvm::cast<llvm::CallInst>(&I);
 
-  debug() << "[enumerator] working on slice\n" << F << "\n";
+      auto callee = CI->getCalledFunction();
+      if(!callee)
+        continue;
+      if (!callee->getName().starts_with("__fksv"))
+        continue;
 
-  clock_t start = std::clock();
+      auto shuf = new llvm::ShuffleVectorInst(
+          CI->getArgOperand(0), CI->getArgOperand(1), CI->getArgOperand(2),
+          "", CI->getIterator());
+      CI->replaceAllUsesWith(shuf);
+      CI->eraseFromParent();
+    }
+  }
+}
 
-  llvm::DominatorTree DT(F);
-  DT.recalculate(F);
+// a sketch that is a single shuffle whose only hole is the mask gets the mask
+// from lane provenance instead of constant synthesis
+static pair<llvm::Argument*, llvm::Constant*>
+solveShuffle(Inst *G, llvm::Instruction *Root,
+             const unordered_map<const llvm::Argument*, ReservedConst*> &RCs) {
+  auto *SV = dynamic_cast<FakeShuffleInst*>(G);
+  if (!SV || RCs.size() != 1 || RCs.begin()->second != SV->M())
+    return {nullptr, nullptr};
+  return {SV->M()->getA(), solveShuffleMask(Root, SV)};
+}
 
-  std::unordered_set<llvm::Function *> IntrinsicDecls;
+// bounds of the explicit enumeration of holes: the number of assignments of
+// a sketch, the concrete tests each assignment is screened with, and the
+// number of assignments worth verifying one by one rather than synthesizing
+static constexpr unsigned MaxAssignments = 256;
+static constexpr unsigned ScreenRounds = 8;
+static constexpr unsigned MaxSurvivors = 16;
 
-  unsigned src_cost = get_approx_cost(&F);
+namespace {
+struct Enumeration {
+  bool Good = false;
+  bool TimedOut = false;
+  unsigned Queries = 0;
+};
+}
 
-  llvm::DataLayout DL = F.getParent()->getDataLayout();
+// Holes with few meaningful values, by their domain, are solved by trying
+// each assignment in turn. Assignments that compute a different value than src on a concrete
+// input are dropped, and the survivors are checked by quantifier free
+// refinement queries. Returns nullopt when the sketch does not qualify, and
+// constant synthesis has to be used.
+static optional<Enumeration>
+enumerateHoles(AliveEngine &AE, llvm::Function &Src, llvm::Function &Tgt,
+    const unordered_map<const llvm::Argument*, ReservedConst*> &ArgConst,
+    unordered_map<llvm::Argument*, llvm::Constant*> &Result) {
+  vector<pair<llvm::Argument*, const Domain*>> Holes;
+  uint64_t Assignments = 1;
+  for (auto &A : Tgt.args()) {
+    auto It = ArgConst.find(&A);
+    if (It == ArgConst.end())
+      continue;
+    auto &D = It->second->getDomain();
+    uint64_t N = D.size();
+    if (!N || N > MaxAssignments || !A.getType()->isIntegerTy())
+      return nullopt;
+    Assignments *= N;
+    if (Assignments > MaxAssignments)
+      return nullopt;
+    Holes.emplace_back(&A, &D);
+  }
+  if (Holes.empty())
+    return nullopt;
+
+  // the holes are placeholders in src, which does not use them
+  vector<llvm::Constant*> Args;
+  for (auto &A : Tgt.args())
+    Args.push_back(llvm::PoisonValue::get(A.getType()));
+
+  vector<pair<vector<llvm::Constant*>, llvm::Constant*>> Tests;
+  mt19937_64 R(config::smt_seed);
+  for (unsigned Round = 0; Round < ScreenRounds; ++Round) {
+    bool Concrete = true;
+    for (auto &A : Tgt.args()) {
+      if (ArgConst.count(&A))
+        continue;
+      auto *C = testInput(A.getType(), Round, R);
+      Concrete &= C != nullptr;
+      if (C)
+        Args[A.getArgNo()] = C;
+    }
+    if (!Concrete)
+      break;
+    if (auto *Out = evaluate(Src, Args))
+      Tests.emplace_back(Args, Out);
+  }
 
-  llvm::Triple Triple = llvm::Triple(F.getParent()->getTargetTriple());
-  llvm::TargetLibraryInfoWrapperPass TLI(Triple);
+  vector<vector<llvm::Constant*>> Survivors;
+  vector<uint64_t> Vals(Holes.size(), 0);
+  while (true) {
+    vector<llvm::Constant*> Cs;
+    for (auto [H, V] : llvm::zip(Holes, Vals))
+      Cs.push_back(llvm::ConstantInt::get(H.first->getType(),
+                                          H.second->value(V)));
+
+    bool Refuted = false;
+    for (auto &[In, Out] : Tests) {
+      for (auto [H, C] : llvm::zip(Holes, Cs))
+        In[H.first->getArgNo()] = C;
+      auto *TOut = evaluate(Tgt, In);
+      if (TOut && differs(Out, TOut)) {
+        Refuted = true;
+        break;
+      }
+    }
+    if (Refuted)
+      stats::count(stats::Screened);
+    else
+      Survivors.push_back(std::move(Cs));
+    if (Survivors.size() > MaxSurvivors)
+      return nullopt;
+
+    // the next assignment, the first hole varies fastest
+    unsigned i = 0;
+    for (; i < Holes.size() && ++Vals[i] == Holes[i].second->size(); ++i)
+      Vals[i] = 0;
+    if (i == Holes.size())
+      break;
+  }
 
-  unsigned costBefore = get_machine_cost(&F);
+  debug() << "[enumerator] " << Survivors.size() << " of " << Assignments
+          << " hole assignments survive " << Tests.size() << " tests\n";
 
-  unsigned Width = I->getType()->getScalarSizeInBits();
-  llvm::KnownBits KnownI(Width);
-  if (I->getType()->isIntOrIntVectorTy())
-    computeKnownBits(I, KnownI, DL);
+  Enumeration E;
+  for (auto &Cs : Survivors) {
+    llvm::ValueToValueMapTy VMap;
+    llvm::Function *Clone = llvm::CloneFunction(&Tgt, VMap);
+    auto Erase = llvm::make_scope_exit([&] { Clone->eraseFromParent(); });
+    for (auto [H, C] : llvm::zip(Holes, Cs))
+      Clone->getArg(H.first->getArgNo())->replaceAllUsesWith(C);
+    E.Good = AE.compareFunctions(Src, *Clone, /*AssumeNoPoison=*/true);
+    E.TimedOut |= AE.timedOut();
+    E.Queries += !AE.cached();
+    if (E.Good) {
+      for (auto [H, C] : llvm::zip(Holes, Cs))
+        Result[H.first] = C;
+      break;
+    }
+  }
+  return E;
+}
+
+static unsigned machineCost(llvm::Function *F) {
+  stats::PhaseTimer T(stats::MachineCost);
+  return get_machine_cost(F);
+}
+
+vector<Rewrite> Enumerator::solve(llvm::Function &F, llvm::Instruction *I,
+                                  const SketchFilter &First, bool *FromFirst) {
+  // the sketches of an earlier solve stay alive in exprs, not their inputs
+  values.clear();
+
+  debug() << "[enumerator] working on slice\n" << F << "\n";
+
+  llvm::DominatorTree DT(F);
+  DT.recalculate(F);
 
+  optional<stats::PhaseTimer> SketchTimer(in_place, stats::Sketches);
   findInputs(F, I, DT);
 
   vector<Sketch> Sketches;
@@ -738,6 +950,68 @@ vector<Rewrite> Enumerator::solve(llvm::Function &F, llvm::Instruction *I) {
   }
 
   getSketches(&*I, Sketches);
+  if (FromFirst)
+    *FromFirst = false;
+  if (!First) {
+    SketchTimer.reset();
+    return verify(F, I, Sketches);
+  }
+
+  auto Mid = std::stable_partition(Sketches.begin(), Sketches.end(),
+                                   [&](const Sketch &S) {
+                                     return First(S.first);
+                                   });
+  vector<Sketch> Rest(make_move_iterator(Mid),
+                      make_move_iterator(Sketches.end()));
+  Sketches.erase(Mid, Sketches.end());
+  SketchTimer.reset();
+
+  // both rounds verify against the same slice
+  CostBefore = machineCost(&F);
+  auto Reset = llvm::make_scope_exit([&] { CostBefore.reset(); });
+  if (!Sketches.empty()) {
+    auto RHSs = verify(F, I, Sketches);
+    if (!RHSs.empty()) {
+      if (FromFirst)
+        *FromFirst = true;
+      return RHSs;
+    }
+  }
+  return verify(F, I, Rest);
+}
+
+vector<Rewrite> Enumerator::verify(llvm::Function &F, llvm::Instruction *I,
+                                   vector<Sketch> &Sketches,
+                                   vector<unique_ptr<Inst>> &&Insts) {
+  unsigned CANDIDATES = 0, PRUNED = 0, GOOD = 0;
+  vector<Rewrite> ret;
+  Candidates = Verified = Timeouts = 0;
+  OutOfTime = false;
+  for (auto &E : Insts)
+    exprs.emplace_back(std::move(E));
+
+  clock_t start = std::clock();
+  auto outOfTime = [&] {
+    double Duration = double(std::clock() - start) / CLOCKS_PER_SEC;
+    return Duration > config::slice_to;
+  };
+
+  std::unordered_set<llvm::Function *> IntrinsicDecls;
+
+  unsigned src_cost = get_approx_cost(&F);
+
+  llvm::DataLayout DL = F.getParent()->getDataLayout();
+
+  llvm::Triple Triple = llvm::Triple(F.getParent()->getTargetTriple());
+  llvm::TargetLibraryInfoWrapperPass TLI(Triple);
+
+  unsigned costBefore = CostBefore ? *CostBefore : machineCost(&F);
+
+  unsigned Width = I->getType()->getScalarSizeInBits();
+  llvm::KnownBits KnownI(Width);
+  if (I->getType()->isIntOrIntVectorTy())
+    computeKnownBits(I, KnownI, DL);
+
   debug() << "[enumerator] listing sketches\n";
   for (auto &Sketch : Sketches) {
     debug() << *Sketch.first << "\n";
@@ -747,7 +1021,14 @@ vector<Rewrite> Enumerator::solve(llvm::Function &F, llvm::Instruction *I) {
 
   vector<Candidate> Fns;
   auto FT = F.getFunctionType();
+  // the source of a sketch with constants only differs from F by the
+  // reserved constant arguments, it is shared by the sketches of the same
+  // signature
+  map<vector<llvm::Type*>, llvm::Function*> Srcs;
+  // F narrowed for lane parallel candidates, by lane count
+  map<unsigned, llvm::Function*> Narrowed;
   // sketches -> llvm functions
+  optional<stats::PhaseTimer> CloneTimer(in_place, stats::Cloning);
 
   for (auto &Sketch : Sketches) {
     bool HaveC = !Sketch.second.empty();
@@ -792,12 +1073,14 @@ vector<Rewrite> Enumerator::solve(llvm::Function &F, llvm::Instruction *I) {
     llvm::CloneFunctionInto(Tgt, &F, VMap,
       llvm::CloneFunctionChangeType::LocalChangesOnly, _returns);
 
-    llvm::Function *Src;
+    llvm::Function *Src = &F;
     if (HaveC) {
-      llvm::ValueToValueMapTy _vs;
-      Src = llvm::CloneFunction(Tgt, _vs);
-    } else {
-      Src = &F;
+      auto &S = Srcs[vector<llvm::Type*>(Args.begin(), Args.end())];
+      if (!S) {
+        llvm::ValueToValueMapTy _vs;
+        S = llvm::CloneFunction(Tgt, _vs);
+      }
+      Src = S;
     }
 
     llvm::Instruction *PrevI = llvm::cast<llvm::Instruction>(VMap[&*I]);
@@ -828,46 +1111,157 @@ vector<Rewrite> Enumerator::solve(llvm::Function &F, llvm::Instruction *I) {
 
     // check cost
     if (tgt_cost >= src_cost) {
+      ++PRUNED;
       skip = true;
       goto push;
     }
 push:
     if (skip) {
       Tgt->eraseFromParent();
-      if (HaveC)
-        Src->eraseFromParent();
     } else {
       Fns.push_back(make_tuple(Tgt, Src, G, ArgConst, !Sketch.second.empty()));
     }
   }
-  std::stable_sort(Fns.begin(), Fns.end(), approx);
+  CloneTimer.reset();
+  {
+    stats::PhaseTimer T(stats::ApproxCost);
+    approx(Fns, F);
+  }
   // llvm functions -> alive2 functions
+  AliveEngine AE(TLI);
   auto iter = Fns.begin();
 
-  for (;iter != Fns.end();) {
+  // portfolio: a first round with the fast timeout refutes most candidates,
+  // the ones the solver gave up on are deferred to a second round with the
+  // full timeout and another seed
+  bool Portfolio = config::query_fast_to &&
+                   config::query_fast_to < config::query_to;
+  bool Retrying = false;
+  vector<Candidate> Deferred;
+  if (Portfolio)
+    AE.setTimeout(config::query_fast_to);
+
+  while (true) {
+    if (iter == Fns.end()) {
+      if (Retrying || Deferred.empty())
+        break;
+      debug() << "[enumerator] retrying " << Deferred.size()
+              << " candidates with the full timeout\n";
+      Retrying = true;
+      stats::count(stats::SMTRetries, Deferred.size());
+      Fns = std::move(Deferred);
+      Deferred.clear();
+      iter = Fns.begin();
+      AE.setTimeout(config::query_to);
+      smt::set_random_seed(to_string(config::smt_seed + 1));
+      continue;
+    }
+
     auto &[Tgt, Src, G, ArgConst, HaveC] = *iter;
     unsigned tgt_cost = get_approx_cost(Tgt);
     debug() << "[enumerator] approx_cost(tgt) = " << tgt_cost
             << ", approx_cost(src) = " << src_cost <<"\n";
     debug() << *Tgt;
 
-    bool Good = false;
-    unordered_map<llvm::Argument*, llvm::Constant*> ConstantResults;
+    trace::Span CandidateSpan("candidate");
+    if (trace::enabled()) {
+      string Sketch;
+      llvm::raw_string_ostream SS(Sketch);
+      SS << *G;
+      CandidateSpan.arg("sketch", SS.str()).arg("approx-cost", tgt_cost);
+    }
+
+    // the source is shared, give its constants the names of this candidate,
+    // in two steps since the names may be swapped
+    if (HaveC) {
+      for (auto &A : Src->args())
+        A.setName("");
+      for (auto [SA, TA] : llvm::zip(Src->args(), Tgt->args()))
+        SA.setName(TA.getName());
+    }
 
-    try {
-      if (!HaveC) {
-        AliveEngine AE(TLI, false);
-        Good = AE.compareFunctions(*Src, *Tgt);
+    bool Good = false, TimedOut = false;
+    unordered_map<llvm::Argument*, llvm::Constant*> ConstantResults;
+    double Seconds;
+
+    {
+      stats::PhaseTimer T(stats::SMT);
+      optional<Enumeration> Enumerated;
+      try {
+        auto [MaskArg, Mask] = solveShuffle(G, I, ArgConst);
+        unsigned Lanes = HaveC ? 0 :
+          reducibleLanes(*Src, *Tgt, config::reduced_lanes);
+        if (Lanes) {
+          debug() << "[enumerator] verifying on " << Lanes
+                  << " lanes first\n";
+          auto &NSrc = Narrowed[Lanes];
+          if (!NSrc)
+            NSrc = reduceLanes(*Src, Lanes, IntrinsicDecls);
+          auto *NTgt = reduceLanes(*Tgt, Lanes, IntrinsicDecls);
+          auto Erase = llvm::make_scope_exit([&] { NTgt->eraseFromParent(); });
+          Good = AE.compareFunctions(*NSrc, *NTgt);
+          // the few that hold on fewer lanes are confirmed at full width
+          if (Good)
+            Good = AE.compareFunctions(*Src, *Tgt);
+          CandidateSpan.arg("lanes", Lanes);
+        } else if (!HaveC) {
+          Good = AE.compareFunctions(*Src, *Tgt);
+        } else if (Mask) {
+          // only the final check goes to the solver
+          MaskArg->replaceAllUsesWith(Mask);
+          lowerFakeShuffles(*Tgt);
+          Good = AE.compareFunctions(*Src, *Tgt);
+          if (Good)
+            ConstantResults[MaskArg] = Mask;
+          CandidateSpan.arg("solver", "lanes");
+        } else if ((Enumerated = enumerateHoles(AE, *Src, *Tgt, ArgConst,
+                                                ConstantResults))) {
+          Good = Enumerated->Good;
+          CandidateSpan.arg("solver", "enumeration")
+                       .arg("queries", Enumerated->Queries);
+        } else {
+          Good = AE.constantSynthesis(*Src, *Tgt, ConstantResults, ArgConst);
+        }
+      } catch (AliveException E) {
+        // e.g. slow vcgen, the candidate is dropped like a failed one
+        debug() << E.msg << "\n";
+      }
+      Seconds = T.elapsed();
+      // an enumeration makes any number of queries, possibly none
+      if (Enumerated) {
+        TimedOut = Enumerated->TimedOut;
+        if (Enumerated->Queries)
+          stats::recordQuery(Seconds);
       } else {
-        AliveEngine AE(TLI, true);
-        Good = AE.constantSynthesis(*Src, *Tgt, ConstantResults);
+        TimedOut = AE.timedOut();
+        if (AE.cached())
+          stats::count(stats::SMTCacheHits);
+        else
+          stats::recordQuery(Seconds);
       }
-    } catch (AliveException E) {
-      debug() << E.msg << "\n";
-      if (E.msg == "slow vcgen") {
+    }
+    ++Verified;
+    if (TimedOut) {
+      stats::count(stats::SMTTimeouts);
+      if (Portfolio && !Retrying) {
+        CandidateSpan.arg("result", "deferred");
+        if (OnCandidate)
+          OnCandidate(G, tgt_cost, Seconds, false);
+        Deferred.push_back(std::move(*iter));
+        iter = Fns.erase(iter);
+        // a run of timeouts in the fast round counts against the slice too
+        if (outOfTime()) {
+          debug() << "[enumerator] timeout for candidate, skipping\n";
+          OutOfTime = true;
+          break;
+        }
         continue;
       }
+      ++Timeouts;
     }
+    CandidateSpan.arg("result", Good ? "good" : "bad");
+    if (OnCandidate)
+      OnCandidate(G, tgt_cost, Seconds, Good);
     if (Good) {
       GOOD ++;
       Inst *R = G;
@@ -879,28 +1273,9 @@ push:
         }
       }
 
-      // rewrite fksv calls to shufflevector
-      for (auto &BB : *Tgt) {
-        for (auto &I : make_early_inc_range(BB)) {
-          if (!isa<llvm::CallInst>(&I))
-            continue;
-          auto CI = llvm::cast<llvm::CallInst>(&I);
+      lowerFakeShuffles(*Tgt);
 
-          auto callee = CI->getCalledFunction();
-          if(!callee)
-            continue;
-          if (!callee->getName().starts_with("__fksv"))
-            continue;
-
-          auto shuf = new llvm::ShuffleVectorInst(
-              CI->getArgOperand(0), CI->getArgOperand(1), CI->getArgOperand(2),
-              "", CI->getIterator());
-          CI->replaceAllUsesWith(shuf);
-          CI->eraseFromParent();
-        }
-      }
-
-      unsigned costAfter = get_machine_cost(Tgt);
+      unsigned costAfter = machineCost(Tgt);
 
       debug() << "[enumerator] optimized ir (uops=" << costAfter <<")"
               << ", original cost (uops=" << costBefore << "), \n"
@@ -917,33 +1292,41 @@ push:
       }
     }
 
-    if (HaveC)
-      Src->eraseFromParent();
     Tgt->eraseFromParent();
 
     iter = Fns.erase(iter);
 
-    unsigned Duration = ( std::clock() - start ) / CLOCKS_PER_SEC;
     if ((config::return_first_solution && Good)) {
       debug() << "[enumerator] returning first solution\n";
       break;
     }
-    if (Duration > config::slice_to) {
+    if (outOfTime()) {
       debug() << "[enumerator] timeout for candidate, skipping\n";
+      OutOfTime = iter != Fns.end() || !Deferred.empty();
       break;
     }
   }
 
-  for (;iter != Fns.end(); ++iter) {
-    auto &[Tgt, Src, _, __, HaveC] = *iter;
-    if (HaveC)
-      Src->eraseFromParent();
-    Tgt->eraseFromParent();
+  for (;iter != Fns.end(); ++iter)
+    get<0>(*iter)->eraseFromParent();
+  for (auto &C : Deferred)
+    get<0>(C)->eraseFromParent();
+  if (Portfolio) {
+    AE.setTimeout(config::query_to);
+    smt::set_random_seed(to_string(config::smt_seed));
   }
+  for (auto &[_, Src] : Srcs)
+    Src->eraseFromParent();
+  for (auto &[_, NSrc] : Narrowed)
+    NSrc->eraseFromParent();
 
   debug() << "[enumerator] #Candidates = "<< CANDIDATES
           << ", #Pruned = " << PRUNED
           << ", #Good = " << GOOD << "\n";
+  Candidates = CANDIDATES;
+  stats::count(stats::Candidates, CANDIDATES);
+  stats::count(stats::Pruned, PRUNED);
+  stats::count(stats::Good, GOOD);
 
   std::stable_sort(ret.begin(), ret.end(),
     [](const Rewrite &a, const Rewrite &b) {
@@ -959,4 +1342,20 @@ push:
   return ret;
 }
 
+NoSolution Enumerator::noSolution() const {
+  NoSolution NS;
+  if (OutOfTime || Timeouts)
+    NS.Reason = "timeout";
+  else if (!Verified)
+    NS.Reason = "no-candidates";
+  else
+    NS.Reason = "exhausted";
+  NS.SliceTo = std::ceil(config::slice_to);
+  NS.QueryTo = config::query_to;
+  NS.Candidates = Candidates;
+  NS.Timeouts = Timeouts;
+  NS.Version = config::minotaur_version;
+  return NS;
+}
+
 } // namespace minotaur
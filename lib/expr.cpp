@@ -27,6 +27,61 @@ void Var::print(raw_ostream &os) const {
   os << "(var " << ty << " " << name <<")";
 }
 
+Domain Domain::range(uint64_t Lo, uint64_t Hi) {
+  Domain D;
+  D.K = Range;
+  D.Lo = Lo;
+  D.Hi = Hi;
+  return D;
+}
+
+Domain Domain::set(vector<uint64_t> Values) {
+  Domain D;
+  D.K = Set;
+  D.Values = std::move(Values);
+  return D;
+}
+
+Domain Domain::lanes(uint64_t Lo, uint64_t Hi) {
+  Domain D;
+  D.K = LaneRange;
+  D.Lo = Lo;
+  D.Hi = Hi;
+  return D;
+}
+
+uint64_t Domain::size() const {
+  switch (K) {
+  case Range: return Hi - Lo;
+  case Set:   return Values.size();
+  default:    return 0;
+  }
+}
+
+uint64_t Domain::value(uint64_t I) const {
+  return K == Set ? Values[I] : Lo + I;
+}
+
+void Domain::print(raw_ostream &os) const {
+  switch (K) {
+  case Any:
+    os << "any";
+    break;
+  case Range:
+    os << "[" << Lo << ", " << Hi << ")";
+    break;
+  case Set:
+    os << "{";
+    for (unsigned i = 0; i < Values.size(); ++i)
+      os << (i ? ", " : "") << Values[i];
+    os << "}";
+    break;
+  case LaneRange:
+    os << "lanes [" << Lo << ", " << Hi << ")";
+    break;
+  }
+}
+
 void ReservedConst::print(raw_ostream &os) const {
   if (C) {
     os << "(reservedconst " << ty << " |" << *C << "|)";
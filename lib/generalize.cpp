@@ -0,0 +1,192 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "generalize.h"
+#include "config.h"
+#include "stats.h"
+#include "utils.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <regex>
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+struct debug {
+template<class T>
+debug &operator<<(const T &s)
+{
+if (minotaur::config::debug_enumerator)
+  minotaur::config::dbg() << s;
+return *this;
+}
+};
+
+// x86 intrinsics without their isa and width, e.g. pavg_w for both
+// x86_sse2_pavg_w and x86_avx2_pavg_w
+const regex X86Name("x86_[a-z0-9]+_(\\w+?)(?:_(?:128|256|512))?(?=[\\s)])");
+const regex X86Callee("llvm\\.x86\\.[a-z0-9]+\\.(.+?)(?:\\.(?:128|256|512))?$");
+
+void printType(raw_ostream &OS, Type *Ty) {
+  if (Ty->isVectorTy())
+    OS << "v";
+  Ty = Ty->getScalarType();
+  if (Ty->isIntegerTy())
+    OS << "i";
+  else
+    OS << *Ty;
+}
+
+}
+
+namespace minotaur {
+
+string sliceShape(Function &F) {
+  DenseMap<const llvm::Value*, unsigned> Index;
+  string Shape;
+  raw_string_ostream OS(Shape);
+
+  OS << "(";
+  for (auto &A : F.args()) {
+    Index[&A] = Index.size();
+    printType(OS, A.getType());
+    OS << " ";
+  }
+  printType(OS, F.getReturnType());
+  OS << ")";
+
+  for (auto &BB : F) {
+    Index[&BB] = Index.size();
+    for (auto &I : BB)
+      Index[&I] = Index.size();
+  }
+
+  for (auto &BB : F) {
+    OS << "\n#" << Index[&BB] << ":";
+    for (auto &I : BB) {
+      OS << "\n#" << Index[&I] << " = " << I.getOpcodeName();
+      if (auto *C = dyn_cast<CmpInst>(&I))
+        OS << " " << CmpInst::getPredicateName(C->getPredicate());
+      if (unsigned Flags = I.getRawSubclassOptionalData())
+        OS << " f" << Flags;
+      OS << " ";
+      printType(OS, I.getType());
+
+      unsigned NumOps = I.getNumOperands();
+      if (auto *CI = dyn_cast<CallInst>(&I)) {
+        NumOps = CI->arg_size();
+        auto *Callee = CI->getCalledFunction();
+        if (!Callee) {
+          OS << " indirect";
+        } else if (Callee->isIntrinsic()) {
+          string Name = Callee->getName().str();
+          smatch M;
+          if (regex_match(Name, M, X86Callee))
+            OS << " x86." << M[1].str();
+          else
+            OS << " " << Intrinsic::getBaseName(Callee->getIntrinsicID());
+        } else {
+          OS << " " << Callee->getName();
+        }
+      }
+
+      for (unsigned i = 0; i < NumOps; ++i) {
+        auto *Op = I.getOperand(i);
+        auto It = Index.find(Op);
+        if (It != Index.end())
+          OS << " #" << It->second;
+        else if (isa<UndefValue>(Op))
+          OS << (isa<PoisonValue>(Op) ? " poison" : " undef");
+        else if (isa<Constant>(Op))
+          OS << " C";
+        else
+          OS << " ?";
+      }
+    }
+  }
+  return Shape;
+}
+
+string rewriteSkeleton(Function &F, Inst *I) {
+  string Printed;
+  raw_string_ostream OS(Printed);
+  I->print(OS);
+
+  // inputs by position, their names differ between slices of the same shape
+  map<string, unsigned> Index;
+  auto add = [&](const llvm::Value &V) {
+    string Name;
+    raw_string_ostream NS(Name);
+    V.printAsOperand(NS, false);
+    Index.emplace(Name, Index.size());
+  };
+  for (auto &A : F.args())
+    add(A);
+  for (auto &BB : F)
+    for (auto &I : BB)
+      if (!I.getType()->isVoidTy())
+        add(I);
+
+  static const regex Const("\\(reservedconst ([^|]*?) (\\|[^|]*\\||null)\\)");
+  static const regex Var("\\(var ([^%]*) (%[^\\s)]+)\\)");
+  string Skeleton = regex_replace(Printed, Const, "(reservedconst $1 C)");
+
+  string Named;
+  auto Begin = Skeleton.cbegin();
+  for (sregex_iterator It(Skeleton.begin(), Skeleton.end(), Var), E;
+       It != E; ++It) {
+    auto &M = *It;
+    Named.append(Begin, M[0].first);
+    auto Pos = Index.find(M[2].str());
+    Named += "(var " + M[1].str() + " #" +
+             (Pos == Index.end() ? M[2].str() : to_string(Pos->second)) + ")";
+    Begin = M[0].second;
+  }
+  Named.append(Begin, Skeleton.cend());
+
+  static const regex Lanes("<\\d+ x ");
+  static const regex IntTy("\\bi\\d+\\b");
+  Skeleton = regex_replace(Named, Lanes, "<? x ");
+  Skeleton = regex_replace(Skeleton, IntTy, "i?");
+  return regex_replace(Skeleton, X86Name, "x86_$1");
+}
+
+vector<Rewrite> solveByShape(Enumerator &EN, Function &F, Instruction *I,
+                             redisContext *c) {
+  if (!config::generalize || !c)
+    return EN.solve(F, I);
+
+  string Shape = sliceShape(F);
+  string Skeleton;
+  if (!hGetShape(Shape, Skeleton, c)) {
+    auto RHSs = EN.solve(F, I);
+    if (!RHSs.empty())
+      hSetShape(Shape, rewriteSkeleton(F, RHSs[0].I), c);
+    return RHSs;
+  }
+
+  // the sketches are generated once, those with the skeleton go first
+  debug() << "[generalize] shape seen before, trying " << Skeleton << "\n";
+  bool Hit;
+  auto RHSs = EN.solve(F, I, [&](Inst *G) {
+    return rewriteSkeleton(F, G) == Skeleton;
+  }, &Hit);
+  if (Hit) {
+    stats::count(stats::ShapeHits);
+    return RHSs;
+  }
+  debug() << "[generalize] the skeleton does not hold for this slice\n";
+  if (!RHSs.empty())
+    hSetShape(Shape, rewriteSkeleton(F, RHSs[0].I), c);
+  return RHSs;
+}
+
+}
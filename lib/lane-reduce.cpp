@@ -0,0 +1,284 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "lane-reduce.h"
+#include "type.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/VectorUtils.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Module.h"
+
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+// the families of x86 binary intrinsics whose lanes are computed
+// independently, by name without the isa and the width
+const char *ParallelFamilies[] = {
+  "pavg_", "pmulh_", "pmulhu_", "pmul_hr_", "psign_",
+  "psrlv_", "psllv_", "psrav_", "psrli_", "pslli_", "psrai_"
+};
+
+struct X86Lanes {
+  string Family;
+  unsigned Lanes;
+  // the second operand is an immediate, the same for all lanes
+  bool ScalarOp1;
+};
+
+class X86Table {
+  DenseMap<unsigned, X86Lanes> ByID;
+  map<pair<string, unsigned>, Intrinsic::ID> ByFamily;
+
+public:
+  X86Table();
+
+  const X86Lanes *lookup(Intrinsic::ID ID) const {
+    auto It = ByID.find(ID);
+    return It == ByID.end() ? nullptr : &It->second;
+  }
+
+  // the member of Family with Lanes lanes, or not_intrinsic
+  Intrinsic::ID member(const string &Family, unsigned Lanes) const {
+    auto It = ByFamily.find({Family, Lanes});
+    return It == ByFamily.end() ? Intrinsic::not_intrinsic : It->second;
+  }
+};
+
+X86Table::X86Table() {
+  const pair<StringRef, Intrinsic::ID> Ops[] = {
+#define PROCESS(NAME, A, B, C, D, E, F) {#NAME, Intrinsic::NAME},
+#include "ir/x86_intrinsics_binop.inc"
+#undef PROCESS
+  };
+
+  for (unsigned K = 0; K < std::size(Ops); ++K) {
+    auto Op = static_cast<IR::X86IntrinBinOp::Op>(K);
+    auto [Name, ID] = Ops[K];
+    // x86_<isa>_<family>[_<width>]
+    Name.consume_front("x86_");
+    Name = Name.split('_').second;
+    if (!Name.consume_back("_128") && !Name.consume_back("_256"))
+      Name.consume_back("_512");
+    if (none_of(ParallelFamilies,
+                [&](const char *P) { return Name.starts_with(P); }))
+      continue;
+
+    minotaur::type Ret = minotaur::getIntrinsicRetTy(Op);
+    minotaur::type Op0 = minotaur::getIntrinsicOp0Ty(Op);
+    minotaur::type Op1 = minotaur::getIntrinsicOp1Ty(Op);
+    bool ScalarOp1 = Op1.getLane() == 1;
+    if (Op0.getLane() != Ret.getLane() || Op0.getBits() != Ret.getBits() ||
+        (!ScalarOp1 && Op1.getLane() != Ret.getLane()))
+      continue;
+
+    ByID[ID] = {Name.str(), Ret.getLane(), ScalarOp1};
+    ByFamily[{Name.str(), Ret.getLane()}] = ID;
+  }
+}
+
+const X86Table &x86Table() {
+  static X86Table T;
+  return T;
+}
+
+struct Shape {
+  unsigned Lanes = 0;
+  // the x86 families used, the narrowed function needs members of them
+  set<string> Families;
+};
+
+bool uniform(Constant *C) {
+  return isa<UndefValue>(C) || C->getSplatValue();
+}
+
+// the slicer appends an unreachable sink block, it has no predecessors in a
+// straight-line slice
+bool isSink(BasicBlock &BB) {
+  return &BB != &BB.getParent()->getEntryBlock() && pred_empty(&BB) &&
+         isa<UnreachableInst>(BB.front());
+}
+
+optional<Shape> shapeOf(Function &F) {
+  for (auto &BB : F) {
+    if (&BB != &F.getEntryBlock() && !isSink(BB))
+      return nullopt;
+  }
+
+  Shape S;
+  auto sameLanes = [&](Type *Ty) {
+    auto *VT = dyn_cast<FixedVectorType>(Ty);
+    if (!VT)
+      return false;
+    if (!S.Lanes)
+      S.Lanes = VT->getNumElements();
+    return VT->getNumElements() == S.Lanes;
+  };
+
+  if (!sameLanes(F.getReturnType()))
+    return nullopt;
+  // scalar arguments are checked at their uses
+  for (auto &A : F.args()) {
+    if (A.getType()->isVectorTy() && !sameLanes(A.getType()))
+      return nullopt;
+  }
+
+  for (auto &I : F.getEntryBlock()) {
+    if (isa<ReturnInst>(&I))
+      continue;
+    if (I.mayReadOrWriteMemory() || !sameLanes(I.getType()))
+      return nullopt;
+
+    // the operand that may be a scalar, the same for all lanes
+    unsigned ScalarOp = ~0u;
+    bool Call = false;
+    if (auto *CI = dyn_cast<CallInst>(&I)) {
+      auto *Callee = CI->getCalledFunction();
+      if (!Callee || !Callee->isIntrinsic())
+        return nullopt;
+      auto ID = Callee->getIntrinsicID();
+      if (auto *X = x86Table().lookup(ID)) {
+        S.Families.insert(X->Family);
+        if (X->ScalarOp1)
+          ScalarOp = 1;
+      } else if (!isTriviallyVectorizable(ID)) {
+        return nullopt;
+      }
+      Call = true;
+    } else if (isa<SelectInst>(&I)) {
+      ScalarOp = 0;
+    } else if (!isa<BinaryOperator, UnaryOperator, CmpInst, CastInst,
+                    FreezeInst>(&I)) {
+      return nullopt;
+    }
+
+    unsigned NumOps = Call ? cast<CallInst>(&I)->arg_size()
+                           : I.getNumOperands();
+    for (unsigned i = 0; i < NumOps; ++i) {
+      auto *Op = I.getOperand(i);
+      auto *C = dyn_cast<Constant>(Op);
+      if (Op->getType()->isVectorTy()) {
+        if (!sameLanes(Op->getType()) || (C && !uniform(C)))
+          return nullopt;
+      } else if (i != ScalarOp && !(Call && C)) {
+        // flags of generic intrinsics are constants
+        return nullopt;
+      }
+    }
+  }
+  return S;
+}
+
+Type *narrow(Type *Ty, unsigned Lanes) {
+  if (auto *VT = dyn_cast<FixedVectorType>(Ty))
+    return FixedVectorType::get(VT->getElementType(), Lanes);
+  return Ty;
+}
+
+Function *narrowIntrinsic(Function *Callee, unsigned Lanes, Module &M) {
+  auto ID = Callee->getIntrinsicID();
+  if (auto *X = x86Table().lookup(ID))
+    return Intrinsic::getOrInsertDeclaration(
+        &M, x86Table().member(X->Family, Lanes));
+
+  SmallVector<Type*, 4> Tys;
+  Intrinsic::getIntrinsicSignature(Callee, Tys);
+  for (auto &Ty : Tys)
+    Ty = narrow(Ty, Lanes);
+  return Intrinsic::getOrInsertDeclaration(&M, ID, Tys);
+}
+
+}
+
+namespace minotaur {
+
+unsigned reducibleLanes(Function &Src, Function &Tgt, unsigned MinLanes) {
+  if (!MinLanes)
+    return 0;
+  auto S = shapeOf(Src);
+  auto T = shapeOf(Tgt);
+  if (!S || !T || S->Lanes != T->Lanes)
+    return 0;
+
+  set<string> Families(S->Families);
+  Families.insert(T->Families.begin(), T->Families.end());
+  // intrinsics only come in some widths
+  for (unsigned Lanes = MinLanes; Lanes < S->Lanes; ++Lanes) {
+    if (all_of(Families, [&](const string &F) {
+          return x86Table().member(F, Lanes) != Intrinsic::not_intrinsic;
+        }))
+      return Lanes;
+  }
+  return 0;
+}
+
+Function *reduceLanes(Function &F, unsigned Lanes,
+                      unordered_set<Function*> &Decls) {
+  SmallVector<Type*, 8> Params;
+  for (auto &A : F.args())
+    Params.push_back(narrow(A.getType(), Lanes));
+  auto *FT = FunctionType::get(narrow(F.getReturnType(), Lanes), Params,
+                               F.isVarArg());
+  auto *R = Function::Create(FT, F.getLinkage(), F.getName() + ".lanes",
+                             F.getParent());
+
+  DenseMap<llvm::Value*, llvm::Value*> Map;
+  for (auto [A, RA] : zip(F.args(), R->args())) {
+    RA.setName(A.getName());
+    Map[&A] = &RA;
+  }
+
+  auto get = [&](llvm::Value *V) -> llvm::Value* {
+    auto *C = dyn_cast<Constant>(V);
+    if (!C)
+      return Map.lookup(V);
+    if (!C->getType()->isVectorTy())
+      return C;
+    if (isa<PoisonValue>(C))
+      return PoisonValue::get(narrow(C->getType(), Lanes));
+    if (isa<UndefValue>(C))
+      return UndefValue::get(narrow(C->getType(), Lanes));
+    return ConstantVector::getSplat(ElementCount::getFixed(Lanes),
+                                    C->getSplatValue());
+  };
+
+  auto *BB = BasicBlock::Create(F.getContext(), "", R);
+  for (auto &I : F.getEntryBlock()) {
+    auto *NI = I.clone();
+    NI->insertInto(BB, BB->end());
+    NI->setName(I.getName());
+    unsigned NumOps = isa<CallInst>(&I) ? cast<CallInst>(&I)->arg_size()
+                                        : I.getNumOperands();
+    for (unsigned i = 0; i < NumOps; ++i)
+      NI->setOperand(i, get(I.getOperand(i)));
+    NI->mutateType(narrow(I.getType(), Lanes));
+    if (auto *CI = dyn_cast<CallInst>(NI)) {
+      auto *Decl = narrowIntrinsic(CI->getCalledFunction(), Lanes,
+                                   *F.getParent());
+      CI->setCalledFunction(Decl);
+      Decls.insert(Decl);
+    }
+    Map[&I] = NI;
+  }
+  for (auto &SBB : F) {
+    if (isSink(SBB))
+      new UnreachableInst(F.getContext(),
+                          BasicBlock::Create(F.getContext(), SBB.getName(), R));
+  }
+  return R;
+}
+
+}
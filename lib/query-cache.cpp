@@ -0,0 +1,140 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "query-cache.h"
+#include "config.h"
+#include "utils.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/TargetParser/Triple.h"
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+bool isNameChar(char C) {
+  return isAlnum(C) || C == '_' || C == '.' || C == '$' || C == '-';
+}
+
+// replaces the whole-word occurrences of From by To
+void replaceName(string &S, StringRef From, StringRef To) {
+  for (size_t Pos = 0; (Pos = S.find(From.data(), Pos, From.size())) !=
+                       string::npos;) {
+    size_t End = Pos + From.size();
+    if (End < S.size() && isNameChar(S[End])) {
+      Pos = End;
+      continue;
+    }
+    S.replace(Pos, From.size(), To.data(), To.size());
+    Pos += To.size();
+  }
+}
+
+string normalize(Function &F) {
+  string S;
+  raw_string_ostream OS(S);
+  F.print(OS);
+  OS.flush();
+
+  replaceName(S, ("@" + F.getName()).str(), "@f");
+  // the enumerator numbers reserved constants across all the sketches of a
+  // slice, only their position matters. The new names cannot clash with the
+  // old ones.
+  unsigned N = 0;
+  for (auto &A : F.args()) {
+    if (A.getName().starts_with("_reservedc"))
+      replaceName(S, ("%" + A.getName()).str(), "%__c" + to_string(N++));
+  }
+  return S;
+}
+
+const char *VerdictNames[] = { "valid", "invalid", "timeout" };
+
+string entryPath(StringRef Key) {
+  SmallString<128> Path(minotaur::config::smt_cache_dir);
+  sys::path::append(Path, Key);
+  return string(Path);
+}
+
+}
+
+namespace minotaur {
+namespace querycache {
+
+bool enabled() {
+  return !config::smt_cache_dir.empty();
+}
+
+string key(StringRef Kind, Function &Src, Function &Tgt) {
+  // memory and pointer queries depend on the layout and the target
+  auto *M = Src.getParent();
+  Triple TT(M->getTargetTriple());
+  string Text = (Twine(config::minotaur_version) + "\n" + Kind + "\n" +
+                 M->getDataLayoutStr() + "\n" + TT.str() + "\n").str();
+  Text += normalize(Src);
+  Text += "\n";
+  Text += normalize(Tgt);
+  return sliceHash(Text);
+}
+
+optional<Entry> lookup(StringRef Key, unsigned TimeoutMs) {
+  auto MB = MemoryBuffer::getFile(entryPath(Key));
+  if (!MB)
+    return nullopt;
+
+  SmallVector<StringRef, 8> Lines;
+  (*MB)->getBuffer().split(Lines, '\n', -1, false);
+  if (Lines.empty())
+    return nullopt;
+
+  auto [Name, Budget] = Lines[0].split(' ');
+  Entry E;
+  if (Budget.getAsInteger(10, E.TimeoutMs))
+    return nullopt;
+  auto *It = llvm::find(VerdictNames, Name);
+  if (It == std::end(VerdictNames))
+    return nullopt;
+  E.V = Verdict(It - std::begin(VerdictNames));
+  for (auto L : drop_begin(Lines))
+    E.Constants.push_back(L.str());
+
+  // a longer timeout may still succeed
+  if (E.V == Timeout && E.TimeoutMs < TimeoutMs)
+    return nullopt;
+  return E;
+}
+
+void store(StringRef Key, const Entry &E) {
+  auto &Dir = config::smt_cache_dir;
+  if (auto EC = sys::fs::create_directories(Dir)) {
+    config::dbg() << "[query-cache] cannot create " << Dir << ": "
+                  << EC.message() << "\n";
+    return;
+  }
+
+  // written aside and renamed, so that concurrent builds never read a
+  // partial entry
+  int FD;
+  SmallString<128> Tmp;
+  SmallString<128> Model(Dir);
+  sys::path::append(Model, "tmp-%%%%%%%%");
+  if (sys::fs::createUniqueFile(Model, FD, Tmp))
+    return;
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << VerdictNames[E.V] << " " << E.TimeoutMs << "\n";
+    for (auto &C : E.Constants)
+      OS << C << "\n";
+  }
+  if (sys::fs::rename(Tmp, entryPath(Key)))
+    sys::fs::remove(Tmp);
+}
+
+} // namespace querycache
+} // namespace minotaur
@@ -0,0 +1,171 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "ranking.h"
+#include "config.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <regex>
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+// the same families as generalize.cpp, with underscores
+const regex X86Name("x86_[a-z0-9]+_(\\w+?)(?:_(?:128|256|512))?");
+const regex X86Callee("llvm\\.x86\\.[a-z0-9]+\\.(.+?)(?:\\.(?:128|256|512))?");
+// the operator of each node of a printed sketch
+const regex Head("\\(([a-z_0-9]+)");
+
+string typeName(Type *Ty) {
+  string S;
+  if (auto *VT = dyn_cast<FixedVectorType>(Ty))
+    S = "v" + to_string(VT->getNumElements());
+  Ty = Ty->getScalarType();
+  if (Ty->isIntegerTy())
+    return S + "i" + to_string(Ty->getIntegerBitWidth());
+  raw_string_ostream OS(S);
+  OS << *Ty;
+  return S;
+}
+
+string opName(Instruction &I) {
+  auto *CI = dyn_cast<CallInst>(&I);
+  auto *Callee = CI ? CI->getCalledFunction() : nullptr;
+  if (!Callee)
+    return I.getOpcodeName();
+  if (!Callee->isIntrinsic())
+    return "call";
+  string Name = Callee->getName().str();
+  smatch M;
+  if (regex_match(Name, M, X86Callee)) {
+    string Family = M[1].str();
+    std::replace(Family.begin(), Family.end(), '.', '_');
+    return Family;
+  }
+  return Intrinsic::getBaseName(Callee->getIntrinsicID()).str();
+}
+
+}
+
+namespace minotaur {
+
+vector<string> sliceFeatures(Function &F) {
+  vector<string> Features;
+  set<string> Ops;
+  for (auto &BB : F) {
+    for (auto &I : BB) {
+      if (auto *RI = dyn_cast<ReturnInst>(&I)) {
+        auto *Root = dyn_cast_or_null<Instruction>(RI->getReturnValue());
+        if (Root)
+          Features.push_back("root:" + opName(*Root));
+        continue;
+      }
+      Ops.insert("op:" + opName(I));
+    }
+  }
+  Features.push_back("ret:" + typeName(F.getReturnType()));
+  Features.insert(Features.end(), Ops.begin(), Ops.end());
+  return Features;
+}
+
+set<string> sketchFamilies(Inst *I) {
+  string S;
+  raw_string_ostream OS(S);
+  I->print(OS);
+
+  set<string> Families;
+  for (sregex_iterator It(S.begin(), S.end(), Head), E; It != E; ++It) {
+    string Family = (*It)[1].str();
+    if (Family == "var" || Family == "reservedconst" || Family == "copy")
+      continue;
+    smatch M;
+    if (regex_match(Family, M, X86Name))
+      Family = M[1].str();
+    Families.insert(Family);
+  }
+  return Families;
+}
+
+void RankModel::add(const vector<string> &Features,
+                    const set<string> &Families) {
+  for (auto &F : Features) {
+    ++Slices[F];
+    for (auto &K : Families)
+      ++Solved[{F, K}];
+  }
+}
+
+double RankModel::score(const vector<string> &Features,
+                        const set<string> &Families) const {
+  double Sum = 0;
+  unsigned N = 0;
+  for (auto &F : Features) {
+    auto It = Slices.find(F);
+    unsigned Total = It == Slices.end() ? 0 : It->second;
+    for (auto &K : Families) {
+      auto Jt = Solved.find({F, K});
+      unsigned Hits = Jt == Solved.end() ? 0 : Jt->second;
+      // add-one smoothing, unseen features and families say nothing
+      Sum += log((Hits + 1.0) / (Total + 2.0));
+      ++N;
+    }
+  }
+  return N ? Sum / N : log(0.5);
+}
+
+// one count per line:
+//   slices <feature> <n>
+//   solved <feature> <family> <n>
+bool RankModel::load(StringRef Path) {
+  auto Buf = MemoryBuffer::getFile(Path);
+  if (!Buf)
+    return false;
+
+  SmallVector<StringRef, 0> Lines;
+  (*Buf)->getBuffer().split(Lines, '\n', -1, false);
+  for (auto Line : Lines) {
+    SmallVector<StringRef, 4> Fields;
+    Line.split(Fields, ' ', -1, false);
+    unsigned N;
+    if (Fields.size() == 3 && Fields[0] == "slices" &&
+        !Fields[2].getAsInteger(10, N)) {
+      Slices[Fields[1].str()] = N;
+    } else if (Fields.size() == 4 && Fields[0] == "solved" &&
+               !Fields[3].getAsInteger(10, N)) {
+      Solved[{Fields[1].str(), Fields[2].str()}] = N;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+void RankModel::write(raw_ostream &OS) const {
+  for (auto &[F, N] : Slices)
+    OS << "slices " << F << " " << N << "\n";
+  for (auto &[FK, N] : Solved)
+    OS << "solved " << FK.first << " " << FK.second << " " << N << "\n";
+}
+
+const RankModel *rankModel() {
+  static unique_ptr<RankModel> Model = [] {
+    if (config::rank_model.empty())
+      return unique_ptr<RankModel>();
+    auto M = make_unique<RankModel>();
+    if (!M->load(config::rank_model))
+      report_fatal_error((StringRef)"[ranking] cannot load the ranking model " +
+                         config::rank_model);
+    return M;
+  }();
+  return Model.get();
+}
+
+}
@@ -0,0 +1,170 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "config.h"
+#include "removal-slice.h"
+#include "slice.h"
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+using namespace llvm;
+using namespace std;
+
+struct debug {
+  template<class T>
+  debug &operator<<(const T &s)
+  {
+    if (minotaur::config::debug_slicer)
+      minotaur::config::dbg()<<s;
+    return *this;
+  }
+};
+
+static bool isRemovable(Instruction *i) {
+  if (isa<PHINode>(i) || i->isTerminator())
+    return false;
+  if (i->mayHaveSideEffects() || i->mayReadFromMemory())
+    return false;
+  if (minotaur::isUnsupportedTy(i->getType()))
+    return false;
+  return minotaur::canHarvest(i);
+}
+
+namespace minotaur {
+
+// the slice is confined to the block of the value: walking the block
+// backwards, an instruction is harvested when all of its users are already
+// harvested, i.e. it is dead once the value is replaced. Everything else the
+// harvested instructions use becomes an argument of the slice.
+optional<pair<reference_wrapper<Function>, Instruction*>>
+RemovalSlice::extractExpr(Value &V) {
+  debug() << "[removal-slicer] slicing value " << V << ">>>\n";
+
+  if (discarded_at_precheck) {
+    debug() << "[removal-slicer] function has unsupported arguments\n";
+    return nullopt;
+  }
+
+  assert(isa<Instruction>(&V) && "Expr to be extracted must be a Instruction");
+  Instruction *VI = cast<Instruction>(&V);
+  BasicBlock *VBB = VI->getParent();
+
+  if (!DT.isReachableFromEntry(VBB)) {
+    debug() << "[removal-slicer] value is unreachable, skipping\n";
+    return nullopt;
+  }
+
+  if (!isRemovable(VI)) {
+    debug() << "[removal-slicer] value cannot be harvested, skipping\n";
+    return nullopt;
+  }
+
+  if (Loop *L = LI.getLoopFor(VBB))
+    debug() << "[removal-slicer] value is in " << *L;
+
+  set<Instruction*> insts = { VI };
+  for (auto It = VI->getReverseIterator(), E = VBB->rend(); ++It != E;) {
+    Instruction *I = &*It;
+    if (!isRemovable(I))
+      continue;
+    bool dead = !I->use_empty();
+    for (User *U : I->users()) {
+      if (!insts.count(cast<Instruction>(U))) {
+        dead = false;
+        break;
+      }
+    }
+    if (dead)
+      insts.insert(I);
+  }
+
+  debug() << "[removal-slicer] " << insts.size()
+          << " instructions are harvested\n";
+
+  unsigned name_count = 0;
+  ValueToValueMapTy vmap;
+  vector<Instruction*> cloned_insts;
+  for (auto &I : *VBB) {
+    if (!insts.count(&I))
+      continue;
+
+    if (auto *call = dyn_cast<CallInst>(&I)) {
+      Function *callee = call->getCalledFunction();
+      FunctionCallee intrindecl =
+        M->getOrInsertFunction(callee->getName(), callee->getFunctionType(),
+                               callee->getAttributes());
+      vmap[callee] = intrindecl.getCallee();
+    }
+
+    Instruction *c = I.clone();
+    c->setName("__n" + to_string(name_count++));
+    vmap[&I] = c;
+    mapping[c] = &I;
+    cloned_insts.push_back(c);
+  }
+
+  // operands that are not harvested become arguments
+  vector<Type*> argTys;
+  map<Value*, unsigned> argMap;
+  for (auto *c : cloned_insts) {
+    RemapInstruction(c, vmap, RF_IgnoreMissingLocals);
+    for (auto &op : c->operands()) {
+      if (!isa<Instruction>(op) && !isa<Argument>(op))
+        continue;
+      if (find(cloned_insts.begin(), cloned_insts.end(), op.get()) !=
+          cloned_insts.end())
+        continue;
+      if (argMap.count(op.get()))
+        continue;
+      argMap[op.get()] = argTys.size();
+      argTys.push_back(op->getType());
+    }
+  }
+
+  Function *F = Function::Create(FunctionType::get(V.getType(), argTys, false),
+                                 GlobalValue::ExternalLinkage, "cut", *M);
+  for (auto &arg : F->args())
+    arg.setName("__n" + to_string(name_count++));
+
+  for (auto *c : cloned_insts) {
+    for (auto &op : c->operands()) {
+      auto it = argMap.find(op.get());
+      if (it == argMap.end())
+        continue;
+      Argument *Arg = F->getArg(it->second);
+      mapping[Arg] = op.get();
+      op.set(Arg);
+    }
+  }
+
+  BasicBlock *BB = BasicBlock::Create(Ctx, "entry", F);
+  for (auto *c : cloned_insts)
+    c->insertInto(BB, BB->end());
+  Instruction *Root = cast<Instruction>(vmap[VI]);
+  ReturnInst::Create(Ctx, Root, BB);
+
+  string err;
+  raw_string_ostream err_stream(err);
+  if (verifyFunction(*F, &err_stream)) {
+    llvm::errs() << err << "\n" << *F;
+    report_fatal_error("[removal-slicer] illformed function generated, "
+                       "terminating\n");
+  }
+
+  debug() << *F << "\n" << "<<< end of %" << V.getName() << " <<<\n";
+
+  return pair<reference_wrapper<Function>, Instruction*>(*F, Root);
+}
+
+} // namespace minotaur
@@ -0,0 +1,183 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "shuffle-solver.h"
+#include "config.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+
+#include <optional>
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+struct debug {
+template<class T>
+debug &operator<<(const T &s)
+{
+if (minotaur::config::debug_enumerator)
+  minotaur::config::dbg() << s;
+return *this;
+}
+};
+
+// a chunk of W bits of a value: Idx-th chunk of V, or poison
+struct Lane {
+  llvm::Value *V = nullptr;
+  unsigned Idx = 0;
+};
+
+using Lanes = SmallVector<Lane, 16>;
+
+class Tracker {
+  // width of a chunk, the element width of the shuffle
+  unsigned W;
+  llvm::Value *L, *R;
+  DenseMap<llvm::Value*, optional<Lanes>> Cache;
+
+  optional<unsigned> chunks(Type *Ty) {
+    unsigned Bits = Ty->getPrimitiveSizeInBits().getFixedValue();
+    if (!Bits || Bits % W)
+      return nullopt;
+    return Bits / W;
+  }
+
+  // chunks per element of a vector type
+  optional<unsigned> perElement(Type *Ty) {
+    unsigned Bits = Ty->getScalarSizeInBits();
+    if (!Bits || Bits % W)
+      return nullopt;
+    return Bits / W;
+  }
+
+  optional<Lanes> compute(llvm::Value *V);
+
+public:
+  Tracker(unsigned W, llvm::Value *L, llvm::Value *R) : W(W), L(L), R(R) {}
+
+  optional<Lanes> track(llvm::Value *V) {
+    auto It = Cache.find(V);
+    if (It != Cache.end())
+      return It->second;
+    auto Result = compute(V);
+    Cache[V] = Result;
+    return Result;
+  }
+};
+
+optional<Lanes> Tracker::compute(llvm::Value *V) {
+  auto N = chunks(V->getType());
+  if (!N)
+    return nullopt;
+
+  if (V == L || V == R) {
+    Lanes Result(*N);
+    for (unsigned i = 0; i < *N; ++i)
+      Result[i] = {V, i};
+    return Result;
+  }
+
+  // poison chunks may be anything
+  if (isa<UndefValue>(V))
+    return Lanes(*N);
+
+  if (auto *BC = dyn_cast<BitCastInst>(V))
+    return track(BC->getOperand(0));
+
+  if (auto *SV = dyn_cast<ShuffleVectorInst>(V)) {
+    auto K = perElement(SV->getType());
+    auto A = track(SV->getOperand(0));
+    auto B = track(SV->getOperand(1));
+    if (!K || !A || !B)
+      return nullopt;
+    Lanes In(*A);
+    In.append(B->begin(), B->end());
+    Lanes Result;
+    for (int M : SV->getShuffleMask()) {
+      for (unsigned k = 0; k < *K; ++k)
+        Result.push_back(M < 0 ? Lane() : In[M * *K + k]);
+    }
+    return Result;
+  }
+
+  if (auto *EE = dyn_cast<ExtractElementInst>(V)) {
+    auto *Idx = dyn_cast<ConstantInt>(EE->getIndexOperand());
+    auto K = perElement(EE->getVectorOperandType());
+    auto Vec = track(EE->getVectorOperand());
+    if (!Idx || !K || !Vec)
+      return nullopt;
+    uint64_t Begin = Idx->getZExtValue() * *K;
+    // out of bounds extracts are poison
+    if (Begin + *K > Vec->size())
+      return Lanes(*K);
+    return Lanes(Vec->begin() + Begin, Vec->begin() + Begin + *K);
+  }
+
+  if (auto *IE = dyn_cast<InsertElementInst>(V)) {
+    auto *Idx = dyn_cast<ConstantInt>(IE->getOperand(2));
+    auto K = perElement(IE->getType());
+    auto Vec = track(IE->getOperand(0));
+    auto Elt = track(IE->getOperand(1));
+    if (!Idx || !K || !Vec || !Elt)
+      return nullopt;
+    uint64_t Begin = Idx->getZExtValue() * *K;
+    if (Begin + *K > Vec->size())
+      return Lanes(Vec->size());
+    Lanes Result(*Vec);
+    llvm::copy(*Elt, Result.begin() + Begin);
+    return Result;
+  }
+
+  return nullopt;
+}
+
+}
+
+namespace minotaur {
+
+llvm::Constant *solveShuffleMask(llvm::Instruction *Root,
+                                 FakeShuffleInst *SV) {
+  auto *LV = dynamic_cast<Var*>(SV->L());
+  auto *RV = SV->R() ? dynamic_cast<Var*>(SV->R()) : nullptr;
+  // (sv var, rc, mask) needs constant synthesis for rc
+  if (!LV || (SV->R() && !RV))
+    return nullptr;
+
+  unsigned W = SV->getElementBits();
+  unsigned NumLanes = SV->getRetTy().getLane();
+  unsigned InLanes = SV->getInputTy().getLane();
+  if (Root->getType()->getPrimitiveSizeInBits().getFixedValue() !=
+      NumLanes * W)
+    return nullptr;
+
+  Tracker T(W, LV->V(), RV ? RV->V() : nullptr);
+  auto Out = T.track(Root);
+  if (!Out || Out->size() != NumLanes)
+    return nullptr;
+
+  auto *I32 = Type::getInt32Ty(Root->getContext());
+  SmallVector<llvm::Constant*, 16> Mask;
+  for (auto &L : *Out) {
+    unsigned M;
+    if (!L.V) {
+      // poison in the source, any lane refines it
+      M = 0;
+    } else if (L.V == LV->V() && L.Idx < InLanes) {
+      M = L.Idx;
+    } else if (RV && L.V == RV->V() && L.Idx < InLanes) {
+      M = InLanes + L.Idx;
+    } else {
+      return nullptr;
+    }
+    Mask.push_back(ConstantInt::get(I32, M));
+  }
+
+  debug() << "[shuffle-solver] mask from lane provenance: "
+          << *ConstantVector::get(Mask) << "\n";
+  return ConstantVector::get(Mask);
+}
+
+}
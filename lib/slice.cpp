@@ -4,7 +4,11 @@
 #include "slice.h"
 #include "utils.h"
 
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/CFG.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/Constant.h"
@@ -31,6 +35,22 @@
 using namespace llvm;
 using namespace std;
 
+#define DEBUG_TYPE "minotaur-slicer"
+
+STATISTIC(NumSlices, "Number of slices extracted");
+STATISTIC(NumSliceInsts, "Number of instructions in extracted slices");
+STATISTIC(NumSliceBlocks, "Number of blocks in extracted slices");
+STATISTIC(NumHoisted, "Number of loop-invariant instructions hoisted into "
+                      "slices");
+STATISTIC(NumRejectedType, "Number of values rejected for their type");
+STATISTIC(NumRejectedLoop, "Number of values and operands rejected for a "
+                           "loop boundary or a loop not in simplified form");
+STATISTIC(NumRejectedEmpty, "Number of values with nothing to harvest");
+STATISTIC(NumRejectedCFG, "Number of values rejected for irreducible control "
+                          "flow between their instructions");
+STATISTIC(NumRejectedTerminator, "Number of values rejected for an "
+                                 "unsupported terminator");
+
 struct debug {
   template<class T>
   debug &operator<<(const T &s)
@@ -41,51 +61,192 @@ struct debug {
   }
 };
 
-static bool isUnsupportedTy(llvm::Type *ty) {
+namespace minotaur {
+
+bool isUnsupportedTy(llvm::Type *ty) {
   Type *vsty = ty->getScalarType();
   return ty->isStructTy() || vsty->isPointerTy() ||
          (vsty->isFloatingPointTy() && !vsty->isIEEELikeFPTy()) ||
          ty->isScalableTy() || vsty->isTargetExtTy() || vsty->isX86_AMXTy();
 }
 
-static bool walk(BasicBlock *current, BasicBlock *target,
-                 set<BasicBlock *> &blocks, const DominatorTree &DT) {
-  auto s = [&DT](auto self,
-                 BasicBlock* current,
-                 BasicBlock* target,
-                 set<BasicBlock*>& visited,
-                 set<BasicBlock*>& result) -> bool {
-    if (visited.size() > 20) {
-      debug() << "[slicer] block too distant from root, skipping\n";
+// collects the blocks on the paths from target to current, where every block
+// on a path is dominated by target. A path that takes a back edge (an edge
+// whose destination dominates its source) has to visit the destination twice,
+// so it is enough to look at the CFG without back edges. There, a block is on
+// a path iff it is reachable from target and reaches current, two linear
+// traversals instead of enumerating every path. The CFG without back edges is
+// acyclic unless the region is irreducible, in which case we give up.
+static bool walkPaths(BasicBlock *current, BasicBlock *target,
+                      set<BasicBlock *> &blocks, const DominatorTree &DT) {
+  auto isForwardEdge = [&DT](BasicBlock *src, BasicBlock *dst) {
+    return !DT.dominates(dst, src);
+  };
+
+  // blocks that reach current without leaving the region
+  set<BasicBlock*> reaching = { current };
+  SmallVector<BasicBlock*> worklist = { current };
+  while (!worklist.empty()) {
+    BasicBlock *bb = worklist.pop_back_val();
+    if (bb == target)
+      continue;
+    for (BasicBlock *pred : predecessors(bb)) {
+      if (!DT.dominates(target, pred) || !isForwardEdge(pred, bb))
+        continue;
+      if (reaching.insert(pred).second)
+        worklist.push_back(pred);
+    }
+  }
+
+  if (!reaching.count(target))
+    return true;
+
+  // of those, the blocks reachable from target
+  set<BasicBlock*> region = { target };
+  worklist.push_back(target);
+  while (!worklist.empty()) {
+    BasicBlock *bb = worklist.pop_back_val();
+    if (bb == current)
+      continue;
+    for (BasicBlock *succ : successors(bb)) {
+      if (!reaching.count(succ) || !isForwardEdge(bb, succ))
+        continue;
+      if (region.insert(succ).second)
+        worklist.push_back(succ);
+    }
+  }
+
+  // make sure the region is acyclic by sorting it topologically
+  map<BasicBlock*, unsigned> indegree;
+  for (BasicBlock *bb : region) {
+    if (bb == current)
+      continue;
+    for (BasicBlock *succ : successors(bb))
+      if (region.count(succ) && succ != target && isForwardEdge(bb, succ))
+        ++indegree[succ];
+  }
+  unsigned sorted = 0;
+  worklist.push_back(target);
+  while (!worklist.empty()) {
+    BasicBlock *bb = worklist.pop_back_val();
+    ++sorted;
+    if (bb == current)
+      continue;
+    for (BasicBlock *succ : successors(bb))
+      if (region.count(succ) && succ != target && isForwardEdge(bb, succ))
+        if (--indegree[succ] == 0)
+          worklist.push_back(succ);
+  }
+  if (sorted != region.size()) {
+    debug() << "[slicer] irreducible control flow between "
+            << target->getName() << " and " << current->getName()
+            << ", skipping\n";
+    return false;
+  }
+
+  blocks.insert(region.begin(), region.end());
+  return true;
+}
+
+// checks that depend only on the instruction itself, not on the value being
+// sliced: calls must be to known intrinsics, loads must be from pointer
+// arguments, and operands must be of supported types and free of globals and
+// constant expressions
+bool canHarvest(Instruction *i) {
+  auto ops = i->operands();
+
+  // loads through a pointer argument are harvested, the pointer becomes an
+  // argument of the slice and the memory it points to an input. Stores are
+  // never harvested, so a slice cannot forward a store to a load, and the
+  // sketches have no wide load to merge narrow ones into
+  if (LoadInst *load = dyn_cast<LoadInst>(i)) {
+    if (!load->isSimple()) {
+      debug() << "[slicer] volatile or atomic load\n";
       return false;
     }
+    if (!isa<Argument>(load->getPointerOperand())) {
+      debug() << "[slicer] load is not from a pointer argument\n";
+      return false;
+    }
+    if (isUnsupportedTy(load->getType())) {
+      debug() << "[slicer] load of unsupported type " << *load->getType()
+              << "\n";
+      return false;
+    }
+    return true;
+  }
 
-    if (target == current) {
-        result.insert(visited.begin(), visited.end());
-        return true;
-    } else {
-      for (BasicBlock* pred : predecessors(current)) {
-        bool t = true;
-        if (visited.find(pred) == visited.end() && DT.dominates(target, pred)) {
-            visited.insert(pred);  // Backtrack
-            t = self(self, pred, target, visited, result);
-            visited.erase(pred);
-        }
-        if (!t)
-          return false;
-      }
-      return true;
+  if (CallInst *call = dyn_cast<CallInst>(i)) {
+    auto callee = call->getCalledFunction();
+    if (!callee) {
+      debug() << "[slicer] unknown callee \n";
+      return false;
     }
-  };
-  /*debug () << "[slicer] start walking from " << current->getName() << " to "
-           << target->getName() << "\n";*/
+    if (!callee->isIntrinsic()) {
+      debug() << "[slicer] non-intrinsic call: "
+              << callee->getName() << "\n";
+      return false;
+    }
+    ops = call->args();
+  }
+
+  for (auto &op : ops) {
+    if (isa<GlobalValue>(op)) {
+      debug() << "[slicer] found instruction that uses GlobalValue\n";
+      return false;
+    }
+    if (isa<ConstantExpr>(op)) {
+      debug() << "[slicer] found instruction that uses ConstantExpr\n";
+      return false;
+    }
+    // give up <i31 34, i31 ptrtoint (ptr @external_global to i31)>
+    if (auto c = dyn_cast<Constant>(op)) {
+      if (c->containsConstantExpression())
+        return false;
+    }
+    auto op_ty = op->getType();
+    if (isUnsupportedTy(op_ty)) {
+      debug() << "[slicer] found instruction with operands with type "
+              << *op_ty <<"\n";
+      return false;
+    }
+  }
+  return true;
+}
 
-  set<BasicBlock*> visited = { current };
+// the slice reads all of its loads from the same memory, so a load is only
+// harvested when nothing between it and the root may write to memory
+static bool isUnclobbered(LoadInst *load, Instruction *root) {
+  if (load == root)
+    return true;
+  if (load->getParent() != root->getParent() || !load->comesBefore(root))
+    return false;
+  for (auto it = next(load->getIterator()); &*it != root; ++it) {
+    if (it->mayWriteToMemory())
+      return false;
+  }
+  return true;
+}
 
-  return s(s, current, target, visited, blocks);
+bool Slice::isHarvestable(Instruction *i) {
+  auto [it, inserted] = context.harvestable.try_emplace(i, false);
+  if (inserted)
+    it->second = canHarvest(i);
+  return it->second;
 }
 
-namespace minotaur {
+bool Slice::walk(BasicBlock *from, BasicBlock *to, set<BasicBlock*> &blocks) {
+  auto [it, inserted] = context.paths.try_emplace({from, to});
+  if (inserted) {
+    set<BasicBlock*> path;
+    if (walkPaths(from, to, path, DT))
+      it->second = std::move(path);
+  }
+  if (!it->second)
+    return false;
+  blocks.insert(it->second->begin(), it->second->end());
+  return true;
+}
 
 //  * if a external value is outside the loop, and it does not dominates v,
 //    do not extract it
@@ -96,6 +257,7 @@ Slice::extractExpr(Value &v) {
   Type *vsty = v.getType()->getScalarType();
   if (isUnsupportedTy(vsty)) {
     debug() << "[slicer] unsupported type " << *vsty << "\n";
+    ++NumRejectedType;
     return nullopt;
   }
 
@@ -109,6 +271,7 @@ Slice::extractExpr(Value &v) {
 
     if (!loopv->isLoopSimplifyForm()) {
       debug() << "[slicer] loop is not in simplified form, skipping\n";
+      ++NumRejectedLoop;
       return nullopt;
     }
   }
@@ -120,6 +283,9 @@ Slice::extractExpr(Value &v) {
 
   ValueToValueMapTy vmap;
   set<Instruction*> insts;
+  // loop-invariant instructions from enclosing loops, they are placed in the
+  // entry block of the slice instead of bringing the loop structure along
+  set<Instruction*> hoisted;
 
   worklist.push({&v, 0});
 
@@ -143,36 +309,40 @@ Slice::extractExpr(Value &v) {
       BasicBlock *ibb = i->getParent();
       Loop *loopi = LI.getLoopFor(ibb);
 
-      // do not harvest instructions beyond loop boundry.
-      if (loopi != loopv)
-        continue;
+      // do not harvest instructions beyond loop boundry, unless they are
+      // computed outside of the loop of the value and can be hoisted
+      bool hoist = false;
+      if (loopi != loopv) {
+        if (!loopv || (loopi && !loopi->contains(loopv)) ||
+            isa<PHINode>(i) || !isSafeToSpeculativelyExecute(i)) {
+          ++NumRejectedLoop;
+          continue;
+        }
+        hoist = true;
+      }
 
-      if (loopi && !loopi->isLoopSimplifyForm()) {
+      if (!hoist && loopi && !loopi->isLoopSimplifyForm()) {
         debug() << "[slicer] loop is not in simplified form, skipping\n";
+        ++NumRejectedLoop;
         continue;
       }
 
-      auto ops = i->operands();
+      // filter unknown operation by instruction and by operand type
+      if (!isHarvestable(i))
+        continue;
+
+      if (auto load = dyn_cast<LoadInst>(i); load && !isUnclobbered(load, vi)) {
+        debug() << "[slicer]" << *load << " may be clobbered before the value\n";
+        continue;
+      }
 
-      // filter unknown operation by instruction
       if (CallInst *call = dyn_cast<CallInst>(i)) {
         auto callee = call->getCalledFunction();
-        if (!callee) {
-          debug() << "[slicer] unknown callee \n";
-          continue;
-        }
-        if (!callee->isIntrinsic()) {
-          debug() << "[slicer] non-intrinsic call: "
-                  << callee->getName() << "\n";
-          continue;
-        }
-
         FunctionCallee intrindecl =
             m->getOrInsertFunction(callee->getName(), callee->getFunctionType(),
                                    callee->getAttributes());
 
         vmap[callee] = intrindecl.getCallee();
-        ops = call->args();
       } else if (auto phi = dyn_cast<PHINode>(i)) {
         bool phiHasUnknownIncome = false;
         if (ibb != vbb) {
@@ -200,39 +370,11 @@ Slice::extractExpr(Value &v) {
         }
       }
 
-      // filter unknown operation by operand type
-      bool haveUnknownOperand = false;
-      for (auto &op : ops) {
-        if (isa<GlobalValue>(op)) {
-          debug() << "[slicer] found instruction that uses GlobalValue\n";
-          haveUnknownOperand = true;
-          break;
-        }
-        if (isa<ConstantExpr>(op)) {
-          debug() << "[slicer] found instruction that uses ConstantExpr\n";
-          haveUnknownOperand = true;
-          break;
-        }
-        // give up <i31 34, i31 ptrtoint (ptr @external_global to i31)>
-        if (auto c = dyn_cast<Constant>(op)) {
-          if (c->containsConstantExpression()) {
-            haveUnknownOperand = true;
-            break;
-          }
-        }
-        auto op_ty = op->getType();
-        if (isUnsupportedTy(op_ty)) {
-          debug() << "[slicer] found instruction with operands with type "
-                  << *op_ty <<"\n";
-          haveUnknownOperand = true;
-          break;
-        }
-      }
-      if (haveUnknownOperand) {
-        continue;
-      }
-
       insts.insert(i);
+      if (hoist) {
+        debug() << "[slicer] hoisting" << *i << " into the entry block\n";
+        hoisted.insert(i);
+      }
 
       for (auto &op : i->operands()) {
         if (!isa<Instruction>(op))
@@ -247,6 +389,7 @@ Slice::extractExpr(Value &v) {
   // if no instructions satisfied the criteria of cloning, return null.
   if (insts.empty()) {
     debug() << "[slicer] no eligible instruction can be harvested, skipping\n";
+    ++NumRejectedEmpty;
     return nullopt;
   }
 
@@ -254,6 +397,8 @@ Slice::extractExpr(Value &v) {
   blocks.insert(vbb);
   map<BasicBlock*, set<BasicBlock*>> bb_deps;
   for (auto i : insts) {
+    if (hoisted.count(i))
+      continue;
     blocks.insert(i->getParent());
     // incoming block -> def block
     if (auto *phi = dyn_cast<PHINode>(i)) {
@@ -264,7 +409,7 @@ Slice::extractExpr(Value &v) {
         if (!isa<Instruction>(incomev))
           continue;
         Instruction *incomei = cast<Instruction>(incomev);
-        if (!insts.count(incomei))
+        if (!insts.count(incomei) || hoisted.count(incomei))
           continue;
         if (incomebb == incomei->getParent())
           continue;
@@ -276,7 +421,7 @@ Slice::extractExpr(Value &v) {
         if (!isa<Instruction>(op))
           continue;
         Instruction *op_i = cast<Instruction>(op);
-        if (!insts.count(op_i))
+        if (!insts.count(op_i) || hoisted.count(op_i))
           continue;
         if (op_i->getParent() == i->getParent())
           continue;
@@ -302,7 +447,7 @@ Slice::extractExpr(Value &v) {
       continue;
     Instruction *cond_i = cast<Instruction>(cond);
     BasicBlock *cond_bb = cond_i->getParent();
-    if (insts.contains(cond_i) && cond_bb != bb) {
+    if (insts.contains(cond_i) && !hoisted.count(cond_i) && cond_bb != bb) {
       bb_deps[bb].insert(cond_bb);
     }
   }
@@ -311,13 +456,15 @@ Slice::extractExpr(Value &v) {
     for (auto to : tos) {
       debug() << "[slicer] walking from " << from->getName() << " to "
               << to->getName() << "\n";
-      if (!walk(from, to, blocks, DT)) {
+      if (!walk(from, to, blocks)) {
+        ++NumRejectedCFG;
         return nullopt;
       }
     }
   }
 
-  debug () << "[slicer] " << insts.size() << " instructions are harvested\n";
+  debug () << "[slicer] " << insts.size() << " instructions are harvested, "
+           << hoisted.size() << " of them hoisted out of loops\n";
   for (auto &i : insts) {
     debug() << "[slicer] harvested instruction " << *i << "\n";
   }
@@ -330,8 +477,10 @@ Slice::extractExpr(Value &v) {
   // pass 2
   for (BasicBlock *orig_bb : blocks) {
     Instruction *term = orig_bb->getTerminator();
-    if (!isa<BranchInst>(term) && !isa<ReturnInst>(term))
+    if (!isa<BranchInst>(term) && !isa<ReturnInst>(term)) {
+      ++NumRejectedTerminator;
       return nullopt;
+    }
 
     if (!isa<BranchInst>(term))
       continue;
@@ -339,8 +488,10 @@ Slice::extractExpr(Value &v) {
 
     // skip if condition of a branch is a ConstantExpr
     if (bi->isConditional()) {
-      if (isa<ConstantExpr>(bi->getCondition()))
+      if (isa<ConstantExpr>(bi->getCondition())) {
+        ++NumRejectedTerminator;
         return nullopt;
+      }
     }
   }
 
@@ -361,6 +512,7 @@ Slice::extractExpr(Value &v) {
 
   set<BasicBlock *> cloned_blocks;
   map<BasicBlock *, BasicBlock *> bmap;
+  vector<Instruction *> hoisted_insts;
   {
     // pass 3.1.1;
     // + duplicate BB;
@@ -375,7 +527,7 @@ Slice::extractExpr(Value &v) {
     // + put in instructions
     for (auto &bb : f) {
       for (auto &i : bb) {
-        if (!insts.count(&i))
+        if (!insts.count(&i) || hoisted.count(&i))
           continue;
         BasicBlock *bb = bmap.at(i.getParent());
         cast<Instruction>(vmap[&i])->insertInto(bb, bb->end());
@@ -387,6 +539,17 @@ Slice::extractExpr(Value &v) {
       }
     }
 
+    // hoisted instructions go to the entry block once it is known, in
+    // reverse post order so that defs come before uses
+    for (BasicBlock *bb : ReversePostOrderTraversal<Function*>(&f)) {
+      for (auto &i : *bb) {
+        if (!hoisted.count(&i))
+          continue;
+        hoisted_insts.push_back(cast<Instruction>(vmap[&i]));
+        hoisted_insts.back()->setName("__n" + to_string(name_count++));
+      }
+    }
+
     // pass 3.1.2:
     // + wire branch
     for (BasicBlock *orig_bb : blocks) {
@@ -522,6 +685,10 @@ Slice::extractExpr(Value &v) {
 
   entry->insertInto(F);
 
+  auto hoistpt = entry->getFirstInsertionPt();
+  for (Instruction *i : hoisted_insts)
+    i->insertInto(entry, hoistpt);
+
   for (auto &bb : f) {
     if (bmap.count(&bb)) {
       BasicBlock *nb = bmap[&bb];
@@ -533,8 +700,11 @@ Slice::extractExpr(Value &v) {
 
   sinkbb->insertInto(F);
 
-  // make sure sliced function is loop free.
-  if (!LoopInfo(DominatorTree(*F)).empty())
+  // make sure sliced function is loop free, a back edge is enough to tell
+  // and does not need a dominator tree of the slice
+  SmallVector<pair<const BasicBlock*, const BasicBlock*>> backedges;
+  FindFunctionBackedges(*F, backedges);
+  if (!backedges.empty())
     report_fatal_error("[slicer] a loop is generated, terminating\n");
 
   eliminate_dead_code(*F);
@@ -549,6 +719,11 @@ Slice::extractExpr(Value &v) {
 
   debug()<< *F << "\n" << "<<< end of %" << v.getName() << " <<<\n";
 
+  ++NumSlices;
+  NumSliceInsts += F->getInstructionCount();
+  NumSliceBlocks += F->size();
+  NumHoisted += hoisted.size();
+
 
   return pair<reference_wrapper<Function>, Instruction*>(*F,
     cast<Instruction>(vmap[&v]));
@@ -0,0 +1,237 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "config.h"
+#include "stats.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Timer.h"
+
+#include <array>
+#include <iterator>
+#include <memory>
+#include <string>
+
+using namespace llvm;
+using namespace std;
+
+#define DEBUG_TYPE "minotaur"
+
+STATISTIC(NumSlices, "Number of slices sent to the synthesizer");
+STATISTIC(NumCacheHits, "Number of slices found in the cache");
+STATISTIC(NumCacheMisses, "Number of slices not found in the cache");
+STATISTIC(NumCandidates, "Number of candidates generated");
+STATISTIC(NumPruned, "Number of candidates pruned before verification");
+STATISTIC(NumGood, "Number of candidates verified");
+STATISTIC(NumRewrites, "Number of rewrites applied");
+STATISTIC(NumCostBefore, "Machine cost of the rewritten slices");
+STATISTIC(NumCostAfter, "Machine cost of the rewrites");
+STATISTIC(NumSMTQueries, "Number of SMT queries");
+STATISTIC(NumSMTTimeouts, "Number of SMT queries that timed out");
+STATISTIC(NumSMTRetries, "Number of SMT queries retried after a timeout");
+STATISTIC(NumSMTCacheHits, "Number of SMT queries found in the query cache");
+STATISTIC(NumScreened, "Number of hole values ruled out by concrete tests");
+STATISTIC(NumShapeHits, "Number of slices solved by the rewrite of a shape");
+STATISTIC(NumSaturated, "Number of slices solved by equality saturation");
+
+namespace {
+
+const char *PhaseNames[] = {
+  "slicing", "cache-lookup", "sketches", "cloning", "approx-cost",
+  "machine-cost", "smt", "codegen"
+};
+
+const char *CounterNames[] = {
+  "slices", "cache-hits", "cache-misses", "candidates", "pruned", "good",
+  "rewrites", "cost-before", "cost-after", "smt-queries", "smt-timeouts",
+  "smt-retries", "smt-cache-hits", "screened", "shape-hits",
+  "saturated"
+};
+
+Statistic *CounterStats[] = {
+  &NumSlices, &NumCacheHits, &NumCacheMisses, &NumCandidates, &NumPruned,
+  &NumGood, &NumRewrites, &NumCostBefore, &NumCostAfter, &NumSMTQueries,
+  &NumSMTTimeouts, &NumSMTRetries, &NumSMTCacheHits, &NumScreened,
+  &NumShapeHits, &NumSaturated
+};
+
+static_assert(std::size(PhaseNames) == minotaur::stats::NumPhases);
+static_assert(std::size(CounterNames) == minotaur::stats::NumCounters);
+static_assert(std::size(CounterStats) == minotaur::stats::NumCounters);
+
+// upper bounds of the SMT time histogram buckets, in seconds, the last
+// bucket takes the rest
+constexpr double Buckets[] = { 0.01, 0.1, 1, 10, 60 };
+
+struct PhaseStats {
+  double Wall = 0;
+  double CPU = 0;
+  uint64_t Count = 0;
+  // nesting depth, only the outermost scope of a phase is accounted
+  unsigned Depth = 0;
+};
+
+struct ModuleStats {
+  const Module *M = nullptr;
+  string Source;
+  string ReportPath;
+  array<PhaseStats, minotaur::stats::NumPhases> Phases;
+  array<uint64_t, minotaur::stats::NumCounters> Counters = {};
+  array<uint64_t, std::size(Buckets) + 1> Histogram = {};
+  double SMTTotal = 0;
+};
+
+ModuleStats Current;
+
+Timer &getTimer(minotaur::stats::Phase P) {
+  static TimerGroup TG("minotaur", "Minotaur synthesis phases");
+  static array<unique_ptr<Timer>, minotaur::stats::NumPhases> Timers;
+  if (!Timers[P])
+    Timers[P] = make_unique<Timer>(PhaseNames[P], PhaseNames[P], TG);
+  return *Timers[P];
+}
+
+}
+
+namespace minotaur {
+namespace stats {
+
+PhaseTimer::PhaseTimer(Phase P)
+  : P(P), Wall(chrono::steady_clock::now()), CPU(clock()),
+    Span(PhaseNames[P]) {
+  if (Current.Phases[P].Depth++)
+    return;
+  if (TimePassesIsEnabled)
+    getTimer(P).startTimer();
+}
+
+PhaseTimer::~PhaseTimer() {
+  auto &S = Current.Phases[P];
+  if (--S.Depth)
+    return;
+  S.Wall += elapsed();
+  S.CPU += double(clock() - CPU) / CLOCKS_PER_SEC;
+  ++S.Count;
+  Timer &T = getTimer(P);
+  if (T.isRunning())
+    T.stopTimer();
+}
+
+double PhaseTimer::elapsed() const {
+  chrono::duration<double> D = chrono::steady_clock::now() - Wall;
+  return D.count();
+}
+
+void count(Counter C, uint64_t N) {
+  Current.Counters[C] += N;
+  *CounterStats[C] += N;
+}
+
+void recordQuery(double Seconds) {
+  count(SMTQueries);
+  Current.SMTTotal += Seconds;
+  unsigned B = 0;
+  while (B < std::size(Buckets) && Seconds > Buckets[B])
+    ++B;
+  ++Current.Histogram[B];
+}
+
+void enterModule(const Module &M) {
+  if (Current.M == &M && Current.Source == M.getSourceFileName())
+    return;
+  Current = ModuleStats();
+  Current.M = &M;
+  Current.Source = M.getSourceFileName();
+}
+
+static double hitRatio() {
+  uint64_t Lookups =
+    Current.Counters[CacheHits] + Current.Counters[CacheMisses];
+  return Lookups ? double(Current.Counters[CacheHits]) / Lookups : 0;
+}
+
+void print(raw_ostream &OS) {
+  OS << "[stats] " << Current.Source << "\n";
+  for (unsigned P = 0; P < NumPhases; ++P) {
+    auto &S = Current.Phases[P];
+    if (!S.Count)
+      continue;
+    OS << "[stats] " << PhaseNames[P] << ": " << S.Count << " times, "
+       << llvm::format("%.3f", S.Wall) << "s wall, "
+       << llvm::format("%.3f", S.CPU) << "s cpu\n";
+  }
+  for (unsigned C = 0; C < NumCounters; ++C)
+    OS << "[stats] #" << CounterNames[C] << " = " << Current.Counters[C]
+       << "\n";
+  OS << "[stats] cache hit ratio = " << llvm::format("%.2f", hitRatio())
+     << "\n";
+  OS << "[stats] smt time histogram:";
+  for (unsigned B = 0; B <= std::size(Buckets); ++B) {
+    OS << " ";
+    if (B < std::size(Buckets))
+      OS << "<=" << Buckets[B] << "s:";
+    else
+      OS << ">" << Buckets[B - 1] << "s:";
+    OS << Current.Histogram[B];
+  }
+  OS << "\n";
+}
+
+void writeReport(StringRef Dir) {
+  if (Current.ReportPath.empty()) {
+    SmallString<128> Model(Dir);
+    sys::path::append(Model, "minotaur_stats_%%%%%%%%.json");
+    SmallString<128> Path;
+    sys::fs::createUniquePath(Model, Path, false);
+    Current.ReportPath = string(Path);
+  }
+
+  json::Object Phases;
+  for (unsigned P = 0; P < NumPhases; ++P) {
+    auto &S = Current.Phases[P];
+    Phases[PhaseNames[P]] = json::Object{
+      {"count", int64_t(S.Count)}, {"wall", S.Wall}, {"cpu", S.CPU}};
+  }
+
+  json::Object Counters;
+  for (unsigned C = 0; C < NumCounters; ++C)
+    Counters[CounterNames[C]] = int64_t(Current.Counters[C]);
+
+  json::Array Histogram;
+  for (unsigned B = 0; B <= std::size(Buckets); ++B) {
+    json::Object Bucket{{"count", int64_t(Current.Histogram[B])}};
+    if (B < std::size(Buckets))
+      Bucket["le"] = Buckets[B];
+    Histogram.push_back(std::move(Bucket));
+  }
+
+  json::Object Report{
+    {"version", config::minotaur_version},
+    {"module", Current.Source},
+    {"phases", std::move(Phases)},
+    {"counters", std::move(Counters)},
+    {"smt", json::Object{{"total", Current.SMTTotal},
+                         {"histogram", std::move(Histogram)}}},
+    {"cache", json::Object{{"hits", int64_t(Current.Counters[CacheHits])},
+                           {"misses", int64_t(Current.Counters[CacheMisses])},
+                           {"hit_ratio", hitRatio()}}},
+  };
+
+  error_code EC;
+  raw_fd_ostream OS(Current.ReportPath, EC, sys::fs::OF_Text);
+  if (EC) {
+    config::dbg() << "[stats] cannot write " << Current.ReportPath << ": "
+                  << EC.message() << "\n";
+    return;
+  }
+  OS << formatv("{0:2}", json::Value(std::move(Report))) << "\n";
+}
+
+} // namespace stats
+} // namespace minotaur
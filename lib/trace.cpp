@@ -0,0 +1,125 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "trace.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <mutex>
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+
+// events are written as they complete, the enclosing array is closed when
+// the writer is destroyed at exit
+struct Writer {
+  mutex Lock;
+  unique_ptr<raw_fd_ostream> OS;
+  chrono::steady_clock::time_point Epoch;
+  int64_t Pid = 0;
+  bool First = true;
+
+  ~Writer() {
+    lock_guard<mutex> G(Lock);
+    if (!OS)
+      return;
+    *OS << "\n]}\n";
+    OS->flush();
+  }
+};
+
+Writer &writer() {
+  static Writer W;
+  return W;
+}
+
+int64_t micros(chrono::steady_clock::duration D) {
+  return chrono::duration_cast<chrono::microseconds>(D).count();
+}
+
+}
+
+namespace minotaur {
+namespace trace {
+
+std::atomic<bool> Enabled(false);
+
+void open(StringRef Path) {
+  auto &W = writer();
+  lock_guard<mutex> G(W.Lock);
+  if (W.OS)
+    return;
+
+  W.Pid = sys::Process::getProcessId();
+  string File = Path.str();
+  for (size_t Pos; (Pos = File.find("%p")) != string::npos;)
+    File.replace(Pos, 2, to_string(W.Pid));
+
+  error_code EC;
+  auto OS = make_unique<raw_fd_ostream>(File, EC, sys::fs::OF_Text);
+  if (EC) {
+    errs() << "[trace] cannot open " << File << ": " << EC.message() << "\n";
+    return;
+  }
+  W.OS = std::move(OS);
+  W.Epoch = chrono::steady_clock::now();
+  *W.OS << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  Enabled = true;
+}
+
+Span::Span(const char *Name) {
+  if (!enabled())
+    return;
+  this->Name = Name;
+  Start = chrono::steady_clock::now();
+}
+
+Span &Span::arg(StringRef Key, StringRef Value) {
+  if (Name)
+    Args.emplace_back(Key.str(), Value.str());
+  return *this;
+}
+
+Span &Span::arg(StringRef Key, int64_t Value) {
+  if (Name)
+    Args.emplace_back(Key.str(), to_string(Value));
+  return *this;
+}
+
+Span::~Span() {
+  if (!Name)
+    return;
+  auto End = chrono::steady_clock::now();
+  auto &W = writer();
+
+  json::Object Event{
+    {"name", Name},
+    {"cat", "minotaur"},
+    {"ph", "X"},
+    {"ts", micros(Start - W.Epoch)},
+    {"dur", micros(End - Start)},
+    {"pid", W.Pid},
+    {"tid", int64_t(get_threadid())},
+  };
+  if (!Args.empty()) {
+    json::Object A;
+    for (auto &[K, V] : Args)
+      A[K] = V;
+    Event["args"] = std::move(A);
+  }
+
+  lock_guard<mutex> G(W.Lock);
+  if (!W.OS)
+    return;
+  *W.OS << (W.First ? "\n" : ",\n") << json::Value(std::move(Event));
+  W.First = false;
+}
+
+} // namespace trace
+} // namespace minotaur
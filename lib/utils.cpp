@@ -4,6 +4,7 @@
 
 #include "llvm/Transforms/Scalar/DCE.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/MD5.h"
 
 #include "hiredis.h"
 
@@ -25,8 +26,21 @@ void eliminate_dead_code(Function &F) {
   FPM.run(F, FAM);
 }
 
+string sliceHash(StringRef Slice) {
+  MD5 Hash;
+  Hash.update(Slice);
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  return Result.digest().str().str();
+}
+
 bool hGet(const char* s, unsigned sz, string &Value, redisContext *c) {
-  redisReply *reply = (redisReply *)redisCommand(c, "HGET %b rewrite", s, sz);
+  return hGetField(s, sz, "rewrite", Value, c);
+}
+
+bool hGetField(const char* s, unsigned sz, const char *field, string &Value,
+               redisContext *c) {
+  redisReply *reply = (redisReply *)redisCommand(c, "HGET %b %s", s, sz, field);
   if (!reply || c->err) {
     report_fatal_error((StringRef)"redis error" + c->errstr);
   }
@@ -44,11 +58,28 @@ bool hGet(const char* s, unsigned sz, string &Value, redisContext *c) {
   }
 }
 
+void hIncrProfile(const char *k, unsigned sz_k, uint64_t Weight,
+                  redisContext *c) {
+  if (!Weight)
+    return;
+  redisReply *reply = (redisReply *)redisCommand(c, "HINCRBY %b profile %s",
+    k, sz_k, to_string(Weight).c_str());
+  if (!reply || c->err)
+    report_fatal_error((StringRef)"Redis error: " + c->errstr);
+  if (reply->type != REDIS_REPLY_INTEGER) {
+    report_fatal_error((StringRef)
+      "Redis protocol error for cache fill, didn't expect reply type " +
+      to_string(reply->type));
+  }
+  freeReplyObject(reply);
+}
+
 void hSetRewrite(const char *k, unsigned sz_k,
                  const char *v, unsigned sz_v,
                  StringRef rewrite,
                  redisContext *c,
-                 unsigned costAfter, unsigned costBefore, StringRef FnName) {
+                 unsigned costAfter, unsigned costBefore, StringRef FnName,
+                 uint64_t Weight) {
   redisReply *reply = (redisReply *)redisCommand(c,
     "HSET %b rewrite %s  costafter %s costbefore %s timestamp %s fn %s",
     k, sz_k, rewrite.data(),
@@ -62,13 +93,75 @@ void hSetRewrite(const char *k, unsigned sz_k,
       to_string(reply->type));
   }
   freeReplyObject(reply);
+  hIncrProfile(k, sz_k, Weight, c);
+}
+
+bool NoSolution::worthRetrying(StringRef CurVersion, unsigned CurSliceTo,
+                               unsigned CurQueryTo) const {
+  // nothing is known about entries from before the reasons were recorded
+  if (Reason.empty())
+    return false;
+  if (Version != CurVersion || Reason == "no-infer")
+    return true;
+  if (Reason == "timeout")
+    return CurSliceTo > SliceTo || CurQueryTo > QueryTo;
+  return false;
 }
 
 void hSetNoSolution(const char *k, unsigned sz_k,
                     redisContext *c,
-                    StringRef FnName) {
+                    StringRef FnName, uint64_t Weight, const NoSolution &NS) {
+  redisReply *reply = (redisReply *)redisCommand(c,
+    "HSET %b rewrite <no-sol> timestamp %s fn %s reason %s sliceto %u "
+    "queryto %u candidates %u timeouts %u version %s",
+    k, sz_k, to_string((unsigned long)time(NULL)).c_str(), FnName.data(),
+    NS.Reason.c_str(), NS.SliceTo, NS.QueryTo, NS.Candidates, NS.Timeouts,
+    NS.Version.c_str());
+  if (!reply || c->err)
+    report_fatal_error((StringRef)"Redis error: " + c->errstr);
+  if (reply->type != REDIS_REPLY_INTEGER) {
+    report_fatal_error((StringRef)
+      "Redis protocol error for cache fill, didn't expect reply type " +
+      to_string(reply->type));
+  }
+  freeReplyObject(reply);
+  hIncrProfile(k, sz_k, Weight, c);
+}
+
+void hGetNoSolution(const char *k, unsigned sz_k, NoSolution &NS,
+                    redisContext *c) {
   redisReply *reply = (redisReply *)redisCommand(c,
-    "HSET %b rewrite <no-sol> timestamp %s fn %s",
+    "HMGET %b reason sliceto queryto candidates timeouts version", k, sz_k);
+  if (!reply || c->err)
+    report_fatal_error((StringRef)"Redis error: " + c->errstr);
+  if (reply->type != REDIS_REPLY_ARRAY || reply->elements != 6) {
+    report_fatal_error((StringRef)
+      "Redis protocol error for cache lookup, didn't expect reply type " +
+      to_string(reply->type));
+  }
+  auto field = [&](unsigned i) -> StringRef {
+    auto *e = reply->element[i];
+    return e->type == REDIS_REPLY_STRING ? StringRef(e->str, e->len) : "";
+  };
+  auto number = [&](unsigned i) {
+    unsigned N = 0;
+    field(i).getAsInteger(10, N);
+    return N;
+  };
+  NS.Reason = field(0).str();
+  NS.SliceTo = number(1);
+  NS.QueryTo = number(2);
+  NS.Candidates = number(3);
+  NS.Timeouts = number(4);
+  NS.Version = field(5).str();
+  freeReplyObject(reply);
+}
+
+void hSetPending(const char *k, unsigned sz_k,
+                 redisContext *c,
+                 StringRef FnName, uint64_t Weight) {
+  redisReply *reply = (redisReply *)redisCommand(c,
+    "HSET %b rewrite <pending> timestamp %s fn %s",
     k, sz_k, to_string((unsigned long)time(NULL)).c_str(), FnName.data());
   if (!reply || c->err)
     report_fatal_error((StringRef)"Redis error: " + c->errstr);
@@ -77,8 +170,128 @@ void hSetNoSolution(const char *k, unsigned sz_k,
       "Redis protocol error for cache fill, didn't expect reply type " +
       to_string(reply->type));
   }
-  // static profile
-  reply = (redisReply *)redisCommand(c, "HINCRBY %b profile 1", k, sz_k);
+  freeReplyObject(reply);
+  hIncrProfile(k, sz_k, Weight, c);
+
+  // a slice still in the queue is not queued again
+  reply = (redisReply *)redisCommand(c, "SADD %s %b", PENDING_SET, k, sz_k);
+  if (!reply || c->err)
+    report_fatal_error((StringRef)"Redis error: " + c->errstr);
+  if (reply->type != REDIS_REPLY_INTEGER) {
+    report_fatal_error((StringRef)
+      "Redis protocol error for queue push, didn't expect reply type " +
+      to_string(reply->type));
+  }
+  bool queued = reply->integer == 0;
+  freeReplyObject(reply);
+  if (queued)
+    return;
+
+  reply = (redisReply *)redisCommand(c, "LPUSH %s %b", PENDING_QUEUE, k, sz_k);
+  if (!reply || c->err)
+    report_fatal_error((StringRef)"Redis error: " + c->errstr);
+  if (reply->type != REDIS_REPLY_INTEGER) {
+    report_fatal_error((StringRef)
+      "Redis protocol error for queue push, didn't expect reply type " +
+      to_string(reply->type));
+  }
+  freeReplyObject(reply);
+}
+
+bool hPopPending(string &Key, redisContext *c, bool block) {
+  redisReply *reply = block ?
+    (redisReply *)redisCommand(c, "BRPOP %s 0", PENDING_QUEUE) :
+    (redisReply *)redisCommand(c, "RPOP %s", PENDING_QUEUE);
+  if (!reply || c->err)
+    report_fatal_error((StringRef)"Redis error: " + c->errstr);
+
+  bool popped = false;
+  if (reply->type == REDIS_REPLY_STRING) {
+    Key.assign(reply->str, reply->len);
+    popped = true;
+  } else if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 2) {
+    // BRPOP replies with [queue, value]
+    Key.assign(reply->element[1]->str, reply->element[1]->len);
+    popped = true;
+  } else if (reply->type != REDIS_REPLY_NIL) {
+    report_fatal_error((StringRef)
+      "Redis protocol error for queue pop, didn't expect reply type " +
+      to_string(reply->type));
+  }
+  freeReplyObject(reply);
+  if (!popped)
+    return false;
+
+  reply = (redisReply *)redisCommand(c, "SREM %s %b", PENDING_SET,
+                                     Key.data(), Key.size());
+  if (!reply || c->err)
+    report_fatal_error((StringRef)"Redis error: " + c->errstr);
+  if (reply->type != REDIS_REPLY_INTEGER) {
+    report_fatal_error((StringRef)
+      "Redis protocol error for queue pop, didn't expect reply type " +
+      to_string(reply->type));
+  }
+  freeReplyObject(reply);
+  return true;
+}
+
+void hAddRule(const char *k, unsigned sz_k, redisContext *c) {
+  redisReply *reply = (redisReply *)redisCommand(c, "SADD %s %b", RULES_SET,
+                                                 k, sz_k);
+  if (!reply || c->err)
+    report_fatal_error((StringRef)"Redis error: " + c->errstr);
+  if (reply->type != REDIS_REPLY_INTEGER) {
+    report_fatal_error((StringRef)
+      "Redis protocol error for rule list, didn't expect reply type " +
+      to_string(reply->type));
+  }
+  bool New = reply->integer == 1;
+  freeReplyObject(reply);
+  if (!New)
+    return;
+
+  reply = (redisReply *)redisCommand(c, "RPUSH %s %b", RULES_LIST, k, sz_k);
+  if (!reply || c->err)
+    report_fatal_error((StringRef)"Redis error: " + c->errstr);
+  if (reply->type != REDIS_REPLY_INTEGER) {
+    report_fatal_error((StringRef)
+      "Redis protocol error for rule list, didn't expect reply type " +
+      to_string(reply->type));
+  }
+  freeReplyObject(reply);
+}
+
+void hGetRules(unsigned From, vector<string> &Keys, redisContext *c) {
+  redisReply *reply = (redisReply *)redisCommand(c,
+    "LRANGE %s %u -1", RULES_LIST, From);
+  if (!reply || c->err)
+    report_fatal_error((StringRef)"Redis error: " + c->errstr);
+  if (reply->type != REDIS_REPLY_ARRAY) {
+    report_fatal_error((StringRef)
+      "Redis protocol error for rule list, didn't expect reply type " +
+      to_string(reply->type));
+  }
+  for (size_t i = 0; i < reply->elements; ++i)
+    Keys.emplace_back(reply->element[i]->str, reply->element[i]->len);
+  freeReplyObject(reply);
+}
+
+static string shapeKey(StringRef Shape) {
+  return SHAPE_PREFIX + sliceHash(Shape);
+}
+
+bool hGetShape(StringRef Shape, string &Skeleton, redisContext *c) {
+  string Key = shapeKey(Shape);
+  return hGetField(Key.c_str(), Key.size(), "skeleton", Skeleton, c);
+}
+
+void hSetShape(StringRef Shape, StringRef Skeleton, redisContext *c) {
+  string Key = shapeKey(Shape);
+  redisReply *reply = (redisReply *)redisCommand(c,
+    "HSET %b skeleton %b shape %b timestamp %s",
+    Key.c_str(), Key.size(), Skeleton.data(), Skeleton.size(),
+    Shape.data(), Shape.size(),
+    to_string((unsigned long)time(NULL)).c_str());
   if (!reply || c->err)
     report_fatal_error((StringRef)"Redis error: " + c->errstr);
   if (reply->type != REDIS_REPLY_INTEGER) {
@@ -89,6 +302,46 @@ void hSetNoSolution(const char *k, unsigned sz_k,
   freeReplyObject(reply);
 }
 
+void hScanSlices(function_ref<bool(StringRef Key)> Fn, redisContext *c) {
+  string Cursor = "0";
+  do {
+    redisReply *reply = (redisReply *)redisCommand(c,
+      "SCAN %s COUNT 1000", Cursor.c_str());
+    if (!reply || c->err)
+      report_fatal_error((StringRef)"Redis error: " + c->errstr);
+    if (reply->type != REDIS_REPLY_ARRAY || reply->elements != 2) {
+      report_fatal_error((StringRef)
+        "Redis protocol error for key scan, didn't expect reply type " +
+        to_string(reply->type));
+    }
+    Cursor = reply->element[0]->str;
+    auto *Keys = reply->element[1];
+    for (size_t i = 0; i < Keys->elements; ++i) {
+      StringRef K(Keys->element[i]->str, Keys->element[i]->len);
+      // minotaur:* keys hold bookkeeping such as the synthesis queue
+      if (K.starts_with("minotaur:"))
+        continue;
+      if (!Fn(K)) {
+        freeReplyObject(reply);
+        return;
+      }
+    }
+    freeReplyObject(reply);
+  } while (Cursor != "0");
+}
+
+bool hFindByHash(StringRef HashPrefix, string &Key, redisContext *c) {
+  bool Found = false;
+  hScanSlices([&](StringRef K) {
+    if (!StringRef(sliceHash(K)).starts_with(HashPrefix))
+      return true;
+    Key = K.str();
+    Found = true;
+    return false;
+  }, c);
+  return Found;
+}
+
 void removeUnusedDecls(unordered_set<Function *> IntrinsicDecls) {
   for (auto Intr : IntrinsicDecls) {
     if (Intr->isDeclaration() && Intr->use_empty()) {
@@ -2,12 +2,19 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 #include "codegen.h"
 #include "config.h"
+#include "cost.h"
+#include "egraph.h"
 #include "enumerator.h"
+#include "generalize.h"
 #include "parse.h"
+#include "removal-slice.h"
 #include "slice.h"
+#include "stats.h"
+#include "trace.h"
 #include "util/random.h"
 #include "utils.h"
 
+#include "llvm/Analysis/BlockFrequencyInfo.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Dominators.h"
@@ -23,7 +30,13 @@
 
 #include "hiredis.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
 #include <filesystem>
+#include <limits>
+#include <unordered_set>
 
 using namespace std;
 using namespace llvm;
@@ -38,6 +51,50 @@ llvm::cl::opt<unsigned> smt_to(
     llvm::cl::desc("minotaur: timeout for SMT queries"),
     llvm::cl::init(60), llvm::cl::value_desc("s"));
 
+llvm::cl::opt<unsigned> smt_fast_to(
+    "minotaur-query-fast-to",
+    llvm::cl::desc("minotaur: verify candidates with this timeout first, "
+                   "and retry the ones that time out with the full timeout "
+                   "(0 to disable)"),
+    llvm::cl::init(0), llvm::cl::value_desc("ms"));
+
+llvm::cl::opt<string> smt_cache_dir(
+    "minotaur-smt-cache-dir",
+    llvm::cl::desc("minotaur: remember the verdicts of SMT queries in this "
+                   "directory"),
+    llvm::cl::init(""), llvm::cl::value_desc("dir"));
+
+llvm::cl::opt<unsigned> reduced_width(
+    "minotaur-reduced-width",
+    llvm::cl::desc("minotaur: verify lane parallel candidates on this many "
+                   "lanes first, and only the good ones at full width "
+                   "(0 to disable)"),
+    llvm::cl::init(0), llvm::cl::value_desc("lanes"));
+
+llvm::cl::opt<bool> generalize(
+    "minotaur-generalize",
+    llvm::cl::desc("minotaur: solve slices of a known shape with the rewrite "
+                   "of that shape first, whatever their widths and constants"),
+    llvm::cl::init(false));
+
+llvm::cl::opt<bool> egraph(
+    "minotaur-egraph",
+    llvm::cl::desc("minotaur: first rewrite slices by equality saturation "
+                   "over the cached rewrites, and verify only the result"),
+    llvm::cl::init(false));
+
+llvm::cl::opt<string> rank_model(
+    "minotaur-rank-model",
+    llvm::cl::desc("minotaur: verify candidates of the same approximate cost "
+                   "in the order of this ranking model, see minotaur-rank"),
+    llvm::cl::value_desc("filename"));
+
+llvm::cl::opt<string> cost_table(
+    "minotaur-cost-table",
+    llvm::cl::desc("minotaur: weigh instructions in the approximate cost "
+                   "model by this table, see minotaur-calibrate"),
+    llvm::cl::value_desc("filename"));
+
 llvm::cl::opt<unsigned> slice_to(
     "minotaur-slice-to",
     llvm::cl::desc("minotaur: timeout per slice"),
@@ -98,11 +155,64 @@ llvm::cl::opt<bool> no_slice(
     llvm::cl::desc("minotaur: do not run slicer"),
     llvm::cl::init(false));
 
+llvm::cl::opt<bool> removal_slice(
+    "minotaur-removal-slice",
+    llvm::cl::desc("minotaur: only slice the instructions that become dead "
+                   "when the root is replaced"),
+    llvm::cl::init(false));
+
 llvm::cl::opt<bool> force_infer(
     "minotaur-force-infer",
     llvm::cl::desc("minotaur: force infer even if cache hits"),
     llvm::cl::init(false));
 
+llvm::cl::opt<bool> async_infer(
+    "minotaur-async",
+    llvm::cl::desc("minotaur: queue cache misses for minotaur-worker instead "
+                   "of running synthesizer"),
+    llvm::cl::init(false));
+
+llvm::cl::opt<unsigned> pending_expiry(
+    "minotaur-pending-expiry",
+    llvm::cl::desc("minotaur: treat a slice queued for longer than this as a "
+                   "cache miss, so that it is queued again"),
+    llvm::cl::init(24 * 60 * 60), llvm::cl::value_desc("s"));
+
+llvm::cl::opt<double> hot_fraction(
+    "minotaur-hot-fraction",
+    llvm::cl::desc("minotaur: only synthesize the hottest fraction of slices "
+                   "of a function, ranked by block frequency"),
+    llvm::cl::init(1.0), llvm::cl::value_desc("fraction"));
+
+llvm::cl::opt<unsigned> synthesis_budget(
+    "minotaur-budget",
+    llvm::cl::desc("minotaur: synthesis time budget per module, 0 for no "
+                   "budget"),
+    llvm::cl::init(0), llvm::cl::value_desc("s"));
+
+llvm::cl::opt<bool> budget_per_process(
+    "minotaur-budget-per-process",
+    llvm::cl::desc("minotaur: share one synthesis budget across all modules "
+                   "of the process"),
+    llvm::cl::init(false));
+
+llvm::cl::opt<bool> debug_budget(
+    "minotaur-debug-budget",
+    llvm::cl::desc("minotaur: print the time allocated to and spent on each "
+                   "slice"),
+    llvm::cl::init(false));
+
+llvm::cl::opt<bool> show_stats(
+    "minotaur-show-stats",
+    llvm::cl::desc("minotaur: print per-phase timings and counters"),
+    llvm::cl::init(false));
+
+llvm::cl::opt<string> trace_file(
+    "minotaur-trace-file",
+    llvm::cl::desc("minotaur: write Chrome trace events to the file, %p is "
+                   "replaced by the process id"),
+    llvm::cl::value_desc("filename"));
+
 llvm::cl::opt<string> report_dir("minotaur-report-dir",
   llvm::cl::desc("Save report to disk"), llvm::cl::value_desc("directory"));
 
@@ -127,40 +237,178 @@ debug &operator<<(const T &s)
 }
 };
 
+struct budget_debug {
+template<class T>
+budget_debug &operator<<(const T &s)
+{
+  if (debug_budget)
+    minotaur::config::dbg()<<s;
+  return *this;
+}
+};
+
+// execution weight of a block, PGO counts when the function has a profile,
+// otherwise the static frequency relative to the function entry
+static uint64_t getWeight(const BasicBlock &BB, const BlockFrequencyInfo &BFI,
+                          bool HasProfile) {
+  if (HasProfile) {
+    if (auto Count = BFI.getBlockProfileCount(&BB))
+      return *Count;
+  }
+  uint64_t Entry = std::max<uint64_t>(BFI.getEntryFreq().getFrequency(), 1);
+  return std::max<uint64_t>(BFI.getBlockFreq(&BB).getFrequency() / Entry, 1);
+}
+
+// synthesis time budget of the module (or of the whole process). Each
+// function gets a share of what is left proportional to its number of slice
+// roots among the functions not processed yet, so whatever a function does not
+// spend rolls over to the ones after it.
+class Budget {
+  // the module, by address and by name since a freed module's address may
+  // be reused for the next one
+  const Module *M = nullptr;
+  string ModuleID;
+  double Remaining = 0;
+  unordered_set<const Function*> Done;
+
+  static unsigned size(const Function &F) {
+    unsigned N = 0;
+    for (auto &BB : F)
+      for (auto &I : BB)
+        if (!I.getType()->isVoidTy())
+          ++N;
+    return N;
+  }
+
+public:
+  static bool enabled() { return synthesis_budget != 0; }
+
+  // returns the share of F in seconds, F is marked as processed
+  double enter(const Function &F) {
+    if (!enabled())
+      return std::numeric_limits<double>::infinity();
+
+    const Module *FM = F.getParent();
+    string ID = FM->getModuleIdentifier() + "\n" + FM->getSourceFileName();
+    if (!M || M != FM || ModuleID != ID) {
+      if (!M || !budget_per_process)
+        Remaining = synthesis_budget;
+      Done.clear();
+    }
+    M = FM;
+    ModuleID = std::move(ID);
+
+    // F counts as not processed yet when it is entered again
+    unsigned Left = 0;
+    for (auto &G : *M)
+      if (!G.isDeclaration() && (&G == &F || !Done.count(&G)))
+        Left += size(G);
+    Done.insert(&F);
+
+    if (!Left)
+      return 0;
+    return std::min(Remaining, Remaining * size(F) / Left);
+  }
+
+  void spend(double Seconds) {
+    Remaining = std::max(Remaining - Seconds, 0.0);
+  }
+
+  double remaining() const { return Remaining; }
+};
+
+static Budget budget;
+
+// limits the synthesis of the next slice to Seconds
+static void setSliceTimeout(double Seconds) {
+  config::slice_to = Seconds;
+  // a single query may run past the slice timeout, so cap it as well
+  config::query_to = std::min<double>(smt_to, Seconds) * 1000;
+  smt::set_query_timeout(to_string(config::query_to));
+}
+
+// Span is the trace event of the slice, tagged with the outcome
 static optional<Rewrite>
-infer(Function &F, Instruction *I, redisContext *ctx, Enumerator &EN, parse::Parser &P) {
+infer(Function &F, Instruction *I, redisContext *ctx, Enumerator &EN,
+      parse::Parser &P, uint64_t Weight, trace::Span &Span) {
   string bytecode;
   llvm::raw_string_ostream bs(bytecode);
   //WriteBitcodeToFile(*F.getParent(), bs);
   F.getParent()->print(bs, nullptr);
   bs.flush();
 
+  if (trace::enabled())
+    Span.arg("hash", sliceHash(bytecode));
+
   vector<Rewrite> RHSs;
 
   bool from_cache = false;
 
-  // for caching, minotaur has three modes:
+  // for caching, minotaur has four modes:
   // 1. no_infer: do not run synthesizer
   // 2. force_infer: force synthesizer even if cache hits
-  // 3. normal mode: run synthesizer if cache miss
+  // 3. async: on cache miss, queue the slice for minotaur-worker
+  // 4. normal mode: run synthesizer if cache miss
 
   // check cache only in normal mode
+  stats::count(stats::Slices);
   if (enable_caching && !force_infer && !no_infer) {
     std::string rewrite;
 
-    if (minotaur::hGet(bytecode.c_str(), bytecode.size(), rewrite, ctx)) {
-      if (rewrite == "<no-sol>") {
+    bool hit;
+    {
+      stats::PhaseTimer T(stats::CacheLookup);
+      hit = minotaur::hGet(bytecode.c_str(), bytecode.size(), rewrite, ctx);
+    }
+    // the worker that took the slice may have died, so the slice is queued
+    // again once it has been pending for too long
+    if (hit && rewrite == "<pending>") {
+      string stamp;
+      unsigned long queued = 0;
+      if (hGetField(bytecode.c_str(), bytecode.size(), "timestamp", stamp, ctx))
+        StringRef(stamp).getAsInteger(10, queued);
+      unsigned long now = time(NULL), age = now - min(queued, now);
+      if (age >= pending_expiry) {
+        debug() << "[online] cache matched, but slice has been queued for "
+                << age << "s, treating as a miss: "
+                << F.getName() << "\n";
+        hit = false;
+      }
+    }
+    stats::count(hit ? stats::CacheHits : stats::CacheMisses);
+    if (hit) {
+      NoSolution NS;
+      if (rewrite == "<no-sol>")
+        hGetNoSolution(bytecode.c_str(), bytecode.size(), NS, ctx);
+      if (rewrite == "<no-sol>" &&
+          NS.worthRetrying(config::minotaur_version,
+                           std::ceil(config::slice_to), config::query_to)) {
+        debug() << "[online] cache matched, but the previous run gave up ("
+                << NS.Reason << ") with less budget or an older version, "
+                   "retrying function: " << F.getName() << "\n";
+      } else if (rewrite == "<no-sol>") {
         debug() << "[online] cache matched, but no solution found in "
-                    "previous run, skipping function: "
+                    "previous run (" << NS.Reason << "), skipping function: "
                 << F.getName() << "\n";
+        hIncrProfile(bytecode.c_str(), bytecode.size(), Weight, ctx);
+        Span.arg("result", "cached-no-sol");
+        return nullopt;
+      } else if (rewrite == "<pending>") {
+        debug() << "[online] cache matched, but slice is still queued for "
+                    "synthesis, skipping function: "
+                << F.getName() << "\n";
+        hIncrProfile(bytecode.c_str(), bytecode.size(), Weight, ctx);
+        Span.arg("result", "cached-pending");
         return nullopt;
       } else {
         debug() << "[online] cache matched, using previous solution for "
                     "function: "
                 << F.getName() << "\n";
+        hIncrProfile(bytecode.c_str(), bytecode.size(), Weight, ctx);
         RHSs = P.parse(F, rewrite);
         if (RHSs.empty()) {
           debug() << "[online] failed to parse cached solution\n";
+          Span.arg("result", "cached-unparsable");
           return nullopt;
         }
         debug() << *RHSs[0].I << "\n";
@@ -173,24 +421,40 @@ infer(Function &F, Instruction *I, redisContext *ctx, Enumerator &EN, parse::Par
   if (no_infer) {
   // in no_infer mode, we write no-sol and return
     if (enable_caching) {
-      hSetNoSolution(bytecode.c_str(), bytecode.size(), ctx, F.getName());
+      NoSolution NS;
+      NS.Reason = "no-infer";
+      NS.Version = config::minotaur_version;
+      hSetNoSolution(bytecode.c_str(), bytecode.size(), ctx, F.getName(),
+                     Weight, NS);
     }
     debug() << "[online] skipping synthesizer\n";
+    Span.arg("result", "no-infer");
+    return nullopt;
+  } else if (!from_cache && async_infer && enable_caching && !force_infer) {
+    // leave the program untouched, the next build picks up the rewrite
+    hSetPending(bytecode.c_str(), bytecode.size(), ctx, F.getName(), Weight);
+    debug() << "[online] slice queued for out-of-line synthesis\n";
+    Span.arg("result", "queued");
     return nullopt;
   } else if (!from_cache) {
     // in force_infer mode, as from_cache is always false, we run synthesizer
     // in normal mode, we run synthesizer only when cache misses
     debug() << "[online] working on function:\n" << F;
-    RHSs = EN.solve(F, I);
+    RHSs = solveBySaturation(EN, F, I, ctx);
+    if (RHSs.empty())
+      RHSs = solveByShape(EN, F, I, ctx);
     if (RHSs.empty()) {
       if (enable_caching)
-        hSetNoSolution(bytecode.c_str(), bytecode.size(), ctx, F.getName());
+        hSetNoSolution(bytecode.c_str(), bytecode.size(), ctx, F.getName(),
+                       Weight, EN.noSolution());
+      Span.arg("result", "no-sol");
       return nullopt;
     }
   }
 
   auto R = RHSs[0];
   debug() << "[online] synthesized solution:\n" << *R.I << "\n";
+  Span.arg("result", from_cache ? "cached-rewrite" : "rewrite");
 
   // write back to cache
   if (!from_cache && enable_caching) {
@@ -201,13 +465,18 @@ infer(Function &F, Instruction *I, redisContext *ctx, Enumerator &EN, parse::Par
     rs.flush();
     hSetRewrite(bytecode.c_str(), bytecode.size(),
                 "", 0,
-                rewrite, ctx, R.CostAfter, R.CostBefore, F.getName());
+                rewrite, ctx, R.CostAfter, R.CostBefore, F.getName(), Weight);
   }
+  // for saturation, every slice with a rewrite is a rule, including the ones
+  // solved before saturation was enabled
+  if (enable_caching && config::egraph)
+    hAddRule(bytecode.c_str(), bytecode.size(), ctx);
   return R;
 }
 
 static bool optimize_function(llvm::Function &F, const LoopInfo &LI,
-                              const DominatorTree &DT) {
+                              const DominatorTree &DT,
+                              const BlockFrequencyInfo &BFI) {
   // set up debug output
   raw_ostream *out_file = &errs();
   if (!report_dir.empty()) {
@@ -239,6 +508,9 @@ static bool optimize_function(llvm::Function &F, const LoopInfo &LI,
   }
   config::set_debug(*out_file);
 
+  if (!trace_file.empty())
+    trace::open(trace_file);
+
   debug() << "[online] minotaur version " << config::minotaur_version << " "
           << "working on source: " << F.getParent()->getSourceFileName() << "\n";
 
@@ -253,9 +525,19 @@ static bool optimize_function(llvm::Function &F, const LoopInfo &LI,
   config::debug_codegen = debug_codegen;
   config::debug_parser = debug_parser;
   config::slice_to = slice_to;
+  config::show_stats = show_stats;
   smt::solver_print_queries(smt_verbose);
-
-  smt::set_query_timeout(to_string(smt_to * 1000));
+  stats::enterModule(*F.getParent());
+
+  config::query_to = smt_to * 1000;
+  config::query_fast_to = smt_fast_to;
+  config::smt_cache_dir = smt_cache_dir;
+  config::reduced_lanes = reduced_width;
+  config::generalize = generalize;
+  config::egraph = egraph;
+  config::rank_model = rank_model;
+  config::cost_table = cost_table;
+  smt::set_query_timeout(to_string(config::query_to));
 
   redisContext *ctx = nullptr;
   if (enable_caching) {
@@ -263,11 +545,13 @@ static bool optimize_function(llvm::Function &F, const LoopInfo &LI,
   }
 
   bool changed = false;
+  bool HasProfile = F.getEntryCount().has_value();
 
   if (no_slice) {
     // in this mode we assume only one return point, we do not run slicer,
     // we check if return value can be optimized
-
+    // the function is a single slice, it gets the whole share of the budget
+    double Share = budget.enter(F);
 
     std::unique_ptr<llvm::Module> m;
     ValueToValueMapTy vv;
@@ -301,57 +585,219 @@ static bool optimize_function(llvm::Function &F, const LoopInfo &LI,
       goto final;
     }
 
+    if (Budget::enabled()) {
+      double Cap = std::min<double>(slice_to, Share);
+      if (Cap < 1) {
+        budget_debug() << "[budget] " << F.getName()
+                       << ": budget exhausted, skipping\n";
+        goto final;
+      }
+      setSliceTimeout(Cap);
+    }
+
+    auto Start = std::chrono::steady_clock::now();
     Enumerator EN;
     parse::Parser P(*newF);
-    auto R = infer(*newF, retI, ctx, EN, P);
+    trace::Span Span("slice");
+    Span.arg("fn", F.getName()).arg("root", "ret");
+    auto R = infer(*newF, retI, ctx, EN, P,
+                   getWeight(F.getEntryBlock(), BFI, HasProfile), Span);
+    if (Budget::enabled()) {
+      std::chrono::duration<double> Spent =
+        std::chrono::steady_clock::now() - Start;
+      budget.spend(Spent.count());
+      budget_debug() << "[budget] " << F.getName() << ": allocated "
+                     << config::slice_to << "s, spent " << Spent.count()
+                     << "s, " << budget.remaining() << "s left\n";
+    }
     if (!R.has_value()) {
       goto final;
     }
 
+    stats::PhaseTimer T(stats::Codegen);
     unordered_set<llvm::Function*> IntrinDecls;
     ValueToValueMapTy vmap;
     auto *V = LLVMGen(ret, IntrinDecls).codeGen(R->I, vmap);
     V = llvm::IRBuilder<>(ret).CreateBitCast(V, retI->getType());
     retI->replaceAllUsesWith(V);
+    stats::count(stats::Rewrites);
+    stats::count(stats::CostBefore, R->CostBefore);
+    stats::count(stats::CostAfter, R->CostAfter);
     changed = true;
   } else {
+    // rank the roots by block weight, so that the synthesis budget goes to
+    // the hot code first
+    vector<pair<Instruction*, uint64_t>> Roots;
     for (auto &BB : F) {
-      for (auto &I : make_early_inc_range(BB)) {
+      uint64_t Weight = getWeight(BB, BFI, HasProfile);
+      // with a profile, zero means the block was never executed
+      if (HasProfile && !Weight)
+        continue;
+      for (auto &I : BB) {
         if (I.getType()->isVoidTy())
           continue;
+        Roots.emplace_back(&I, Weight);
+      }
+    }
+    std::stable_sort(Roots.begin(), Roots.end(),
+                     [](const auto &a, const auto &b) {
+                       return a.second > b.second;
+                     });
+
+    double fraction = std::clamp(hot_fraction.getValue(), 0.0, 1.0);
+    size_t hot = std::ceil(Roots.size() * fraction);
+    if (hot < Roots.size()) {
+      debug() << "[online] skipping " << Roots.size() - hot
+              << " cold slices\n";
+      Roots.resize(hot);
+    }
 
-        minotaur::Slice S(F, LI, DT);
-        auto NewF = S.extractExpr(I);
-        auto m = S.getNewModule();
-
-        if (!NewF.has_value())
-          continue;
+    // the budget is split by the estimated benefit of each slice, the cost of
+    // the source slice times its weight. A slice is only kept until its
+    // estimate is taken, it is sliced again when its turn comes.
+    struct Taken {
+      unique_ptr<minotaur::Slice> S;
+      unique_ptr<minotaur::RemovalSlice> RS;
+      unique_ptr<Module> M;
+      Function *SliceF = nullptr;
+      Instruction *SliceRoot = nullptr;
+    };
+    // rewrites only add instructions to F, what SC knows about the others
+    // stays true
+    minotaur::SliceContext SC;
+    auto take = [&](Instruction *Root) {
+      stats::PhaseTimer T(stats::Slicing);
+      Taken Sl;
+      optional<pair<reference_wrapper<Function>, Instruction*>> NewF;
+      if (removal_slice) {
+        Sl.RS = make_unique<minotaur::RemovalSlice>(F, LI, DT);
+        NewF = Sl.RS->extractExpr(*Root);
+        Sl.M = Sl.RS->getNewModule();
+      } else {
+        Sl.S = make_unique<minotaur::Slice>(F, LI, DT, SC);
+        NewF = Sl.S->extractExpr(*Root);
+        Sl.M = Sl.S->getNewModule();
+      }
+      if (NewF.has_value()) {
+        Sl.SliceF = &NewF->first.get();
+        Sl.SliceRoot = NewF->second;
+      }
+      return Sl;
+    };
+
+    struct Candidate {
+      Instruction *I;
+      uint64_t Weight;
+      double Benefit;
+    };
+    vector<Candidate> Candidates;
+    // slicing is charged to the budget as well
+    double Share = budget.enter(F);
+    auto SliceStart = std::chrono::steady_clock::now();
+    for (auto &[Root, Weight] : Roots) {
+      Taken Sl = take(Root);
+      if (!Sl.SliceF)
+        continue;
+      double Benefit =
+        std::max(get_approx_cost(Sl.SliceF), 1u) * (double)Weight;
+      Candidates.push_back({Root, Weight, Benefit});
+    }
+    std::stable_sort(Candidates.begin(), Candidates.end(),
+                     [](const auto &a, const auto &b) {
+                       return a.Benefit > b.Benefit;
+                     });
+
+    std::chrono::duration<double> SliceTime =
+      std::chrono::steady_clock::now() - SliceStart;
+    double Left = Share;
+    if (Budget::enabled()) {
+      Left = std::max(Left - SliceTime.count(), 0.0);
+      budget.spend(SliceTime.count());
+      budget_debug() << "[budget] " << F.getName() << ": slicing took "
+                     << SliceTime.count() << "s\n";
+    }
+    double Pending = 0;
+    for (auto &C : Candidates)
+      Pending += C.Benefit;
+
+    unsigned Done = 0;
+    for (auto &C : Candidates) {
+      Instruction &I = *C.I;
+
+      if (Budget::enabled()) {
+        // every slice gets at least a second, and at most the slice timeout
+        double Cap = std::min<double>(slice_to, Left);
+        if (Cap < 1) {
+          budget_debug() << "[budget] " << F.getName()
+                         << ": budget exhausted, skipping "
+                         << Candidates.size() - Done << " slices\n";
+          break;
+        }
+        setSliceTimeout(std::clamp(Left * C.Benefit / Pending, 1.0, Cap));
+        budget_debug() << "[budget] " << F.getName() << ": slice "
+                       << I.getName() << " benefit " << C.Benefit
+                       << ", allocated " << config::slice_to << "s";
+      }
+      Pending -= C.Benefit;
+      ++Done;
+
+      // slicing again is charged to the slice, the rewrite refers to the
+      // slice, so it is declared first
+      auto Start = std::chrono::steady_clock::now();
+      Taken Sl = take(&I);
+      Enumerator EN;
+      optional<parse::Parser> P;
+      trace::Span Span("slice");
+      Span.arg("fn", F.getName()).arg("root", I.getName())
+          .arg("weight", C.Weight);
+      optional<Rewrite> R;
+      if (Sl.SliceF) {
+        P.emplace(*Sl.SliceF);
+        R = infer(*Sl.SliceF, Sl.SliceRoot, ctx, EN, *P, C.Weight, Span);
+      }
 
-        Enumerator EN;
-        parse::Parser P(NewF->first);
-        auto R = infer(NewF->first, NewF->second, ctx, EN, P);
+      if (Budget::enabled()) {
+        std::chrono::duration<double> Spent =
+          std::chrono::steady_clock::now() - Start;
+        Left = std::max(Left - Spent.count(), 0.0);
+        budget.spend(Spent.count());
+        budget_debug() << ", spent " << Spent.count() << "s\n";
+      }
 
-        if (!R.has_value())
-          continue;
+      if (!R.has_value())
+        continue;
 
-        unordered_set<llvm::Function*> IntrinDecls;
-        Instruction *insertpt = I.getNextNode();
-        while(isa<PHINode>(insertpt)) {
-          insertpt = insertpt->getNextNode();
-        }
+      stats::PhaseTimer T(stats::Codegen);
+      unordered_set<llvm::Function*> IntrinDecls;
+      Instruction *insertpt = I.getNextNode();
+      while(isa<PHINode>(insertpt)) {
+        insertpt = insertpt->getNextNode();
+      }
 
-        auto *V = LLVMGen(insertpt, IntrinDecls).codeGen(R->I, S.getValueMap());
-        V = llvm::IRBuilder<>(insertpt).CreateBitCast(V, I.getType());
+      auto &VMap = Sl.S ? Sl.S->getValueMap() : Sl.RS->getValueMap();
+      auto *V = LLVMGen(insertpt, IntrinDecls).codeGen(R->I, VMap);
+      V = llvm::IRBuilder<>(insertpt).CreateBitCast(V, I.getType());
 
-        I.replaceUsesWithIf(V, [&changed, &V, &DT](Use &U) {
-          if(dom_check(V, DT, U)) {
-            changed = true;
-            return true;
-          }
-          return false;
-        });
+      bool replaced = false;
+      I.replaceUsesWithIf(V, [&replaced, &V, &DT](Use &U) {
+        if(dom_check(V, DT, U)) {
+          replaced = true;
+          return true;
+        }
+        return false;
+      });
+      if (replaced) {
+        stats::count(stats::Rewrites);
+        stats::count(stats::CostBefore, R->CostBefore);
+        stats::count(stats::CostAfter, R->CostAfter);
       }
+      changed |= replaced;
     }
+
+    if (Budget::enabled())
+      budget_debug() << "[budget] " << F.getName() << ": spent "
+                     << Share - Left << "s of " << Share << "s, "
+                     << budget.remaining() << "s left\n";
   }
 
 final:
@@ -369,6 +815,11 @@ final:
     debug() << "[online] minotaur completed, no change to the program\n";
   }
 
+  if (show_stats)
+    stats::print(*out_file);
+  if (!report_dir.empty())
+    stats::writeReport(report_dir);
+
   if (out_file != &errs()) {
     out_file->flush();
     delete out_file;
@@ -384,7 +835,8 @@ struct MinotaurPass : PassInfoMixin<MinotaurPass> {
 
     const LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
     const DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
-    optimize_function(F, LI, DT);
+    const BlockFrequencyInfo &BFI = FAM.getResult<BlockFrequencyAnalysis>(F);
+    optimize_function(F, LI, DT, BFI);
     return PreservedAnalyses::all();
   }
 };
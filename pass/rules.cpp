@@ -0,0 +1,386 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "codegen.h"
+#include "parse.h"
+#include "utils.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+using namespace llvm;
+using namespace minotaur;
+
+#define DEBUG_TYPE "minotaur-rules"
+
+STATISTIC(NumRules, "Number of rules loaded");
+STATISTIC(NumBadRules, "Number of rules that could not be loaded");
+STATISTIC(NumRuleRewrites, "Number of rewrites applied by rules");
+
+namespace {
+
+llvm::cl::opt<bool> debug_rules(
+    "minotaur-rules-debug",
+    llvm::cl::desc("minotaur: print the rules loaded and applied"),
+    llvm::cl::init(false));
+
+llvm::cl::opt<string> rules_file(
+    "minotaur-rules-file",
+    llvm::cl::desc("minotaur: also apply the rules in this file, as written "
+                   "by cache-rulegen"),
+    llvm::cl::value_desc("filename"));
+
+struct debug {
+template<class T>
+debug &operator<<(const T &s)
+{
+if (debug_rules)
+  llvm::errs() << s;
+return *this;
+}
+};
+
+struct RuleText {
+  StringRef Slice;
+  StringRef Rewrite;
+  unsigned CostBefore;
+  unsigned CostAfter;
+};
+
+const vector<RuleText> Table = {
+#define RULE(SLICE, REWRITE, BEFORE, AFTER) {SLICE, REWRITE, BEFORE, AFTER},
+#include "rules.inc"
+#undef RULE
+};
+
+// a table in the format of cache-rulegen:
+//   RULE(R"rule(<slice>)rule", R"rule(<rewrite>)rule", <before>, <after>)
+bool parseRules(StringRef Buf, vector<RuleText> &Rules) {
+  auto token = [&Buf](StringRef T) {
+    Buf = Buf.ltrim();
+    return Buf.consume_front(T);
+  };
+  auto raw = [&](StringRef &S) {
+    StringRef Close = ")rule\"";
+    if (!token("R\"rule("))
+      return false;
+    size_t End = Buf.find(Close);
+    if (End == StringRef::npos)
+      return false;
+    S = Buf.take_front(End);
+    Buf = Buf.drop_front(End + Close.size());
+    return true;
+  };
+  auto number = [&](unsigned &N) {
+    Buf = Buf.ltrim();
+    return !Buf.consumeInteger(10, N);
+  };
+
+  while (true) {
+    Buf = Buf.ltrim();
+    if (Buf.empty())
+      return true;
+    if (Buf.starts_with("//")) {
+      Buf = Buf.split('\n').second;
+      continue;
+    }
+    RuleText T;
+    if (!token("RULE(") || !raw(T.Slice) || !token(",") ||
+        !raw(T.Rewrite) || !token(",") || !number(T.CostBefore) ||
+        !token(",") || !number(T.CostAfter) || !token(")"))
+      return false;
+    Rules.push_back(T);
+  }
+}
+
+// the rules of -minotaur-rules-file, read on first use
+const vector<RuleText> &fileRules() {
+  static unique_ptr<MemoryBuffer> Buf;
+  static const vector<RuleText> Rules = [] {
+    vector<RuleText> Rules;
+    if (rules_file.empty())
+      return Rules;
+    auto B = MemoryBuffer::getFile(rules_file);
+    if (!B || !parseRules((*B)->getBuffer(), Rules))
+      report_fatal_error((StringRef)"[rules] cannot load the rules in " +
+                         rules_file.getValue());
+    Buf = std::move(*B);
+    return Rules;
+  }();
+  return Rules;
+}
+
+// a cached rewrite, with its slice as the pattern
+struct Rule {
+  unique_ptr<Module> M;
+  Function *F;
+  Instruction *Root;
+  unique_ptr<parse::Parser> P;
+  Inst *Rewrite;
+  unsigned Size;
+  unsigned CostBefore;
+  unsigned CostAfter;
+};
+
+// the root of a slice, when the slice is an expression tree the matcher
+// can handle
+Instruction *patternRoot(Function &F) {
+  // the slicer appends a sink block, it is unreachable unless the slice has
+  // several entries
+  auto isSink = [&F](BasicBlock &BB) {
+    return &BB != &F.getEntryBlock() && pred_empty(&BB) &&
+           isa<UnreachableInst>(BB.front());
+  };
+  if (F.size() > 2 || (F.size() == 2 && !isSink(F.back())))
+    return nullptr;
+  auto *Ret = dyn_cast<ReturnInst>(F.getEntryBlock().getTerminator());
+  if (!Ret || !Ret->getReturnValue())
+    return nullptr;
+  for (auto &I : F.getEntryBlock()) {
+    if (&I != Ret && (I.mayReadOrWriteMemory() || I.getType()->isVoidTy()))
+      return nullptr;
+  }
+  return dyn_cast<Instruction>(Ret->getReturnValue());
+}
+
+unique_ptr<Rule> loadRule(const RuleText &T, LLVMContext &Ctx) {
+  SMDiagnostic Err;
+  auto M = parseAssemblyString(T.Slice, Err, Ctx);
+  if (!M) {
+    debug() << "[rules] unparsable slice: " << Err.getMessage() << "\n";
+    return nullptr;
+  }
+
+  Function *F = nullptr;
+  for (auto &Fn : *M) {
+    if (Fn.isDeclaration())
+      continue;
+    if (F)
+      return nullptr;
+    F = &Fn;
+  }
+  Instruction *Root = F ? patternRoot(*F) : nullptr;
+  if (!Root)
+    return nullptr;
+  // a match only binds the arguments the slice uses, the slicer appends an
+  // i16 block selector to every slice, so the rewrite must not use the others
+  for (auto &A : F->args()) {
+    string Name;
+    raw_string_ostream OS(Name);
+    A.printAsOperand(OS, false);
+    if (A.use_empty() && T.Rewrite.contains(" " + Name + ")"))
+      return nullptr;
+  }
+
+  auto R = make_unique<Rule>();
+  R->P = make_unique<parse::Parser>(*F);
+  auto RHSs = R->P->parse(*F, T.Rewrite);
+  if (RHSs.empty())
+    return nullptr;
+  R->M = std::move(M);
+  R->F = F;
+  R->Root = Root;
+  R->Rewrite = RHSs[0].I;
+  R->Size = F->getEntryBlock().size();
+  R->CostBefore = T.CostBefore;
+  R->CostAfter = T.CostAfter;
+  return R;
+}
+
+// Binds the values of a pattern to the values of the program. Arguments of
+// the slice match any value of their type, the same one at each use; other
+// values must match exactly.
+class Matcher {
+  DenseMap<llvm::Value*, llvm::Value*> Binding;
+
+public:
+  bool match(llvm::Value *P, llvm::Value *V);
+  ValueToValueMapTy &getValueMap(ValueToValueMapTy &VMap) const {
+    for (auto [P, V] : Binding)
+      VMap[P] = V;
+    return VMap;
+  }
+};
+
+bool Matcher::match(llvm::Value *P, llvm::Value *V) {
+  if (P->getType() != V->getType())
+    return false;
+
+  auto It = Binding.find(P);
+  if (It != Binding.end())
+    return It->second == V;
+
+  // constants are uniqued in the context
+  if (isa<Constant>(P))
+    return P == V;
+
+  auto *PI = dyn_cast<Instruction>(P);
+  if (PI) {
+    auto *I = dyn_cast<Instruction>(V);
+    if (!I || I->getOpcode() != PI->getOpcode() ||
+        I->getNumOperands() != PI->getNumOperands())
+      return false;
+    // the program may carry more poison flags than the slice, not fewer
+    unsigned Flags = PI->getRawSubclassOptionalData();
+    if ((I->getRawSubclassOptionalData() & Flags) != Flags)
+      return false;
+
+    unsigned NumOps = PI->getNumOperands();
+    if (auto *PC = dyn_cast<CallInst>(PI)) {
+      auto *PCallee = PC->getCalledFunction();
+      auto *Callee = cast<CallInst>(I)->getCalledFunction();
+      if (!PCallee || !Callee || PCallee->getName() != Callee->getName())
+        return false;
+      NumOps = PC->arg_size();
+    } else if (!PI->hasSameSpecialState(I)) {
+      return false;
+    }
+
+    for (unsigned i = 0; i < NumOps; ++i) {
+      if (!match(PI->getOperand(i), I->getOperand(i)))
+        return false;
+    }
+  } else if (!isa<Argument>(P)) {
+    return false;
+  }
+
+  Binding[P] = V;
+  return true;
+}
+
+class RuleSet {
+  vector<unique_ptr<Rule>> Rules;
+  // the rules by the opcode of their root
+  DenseMap<unsigned, SmallVector<Rule*, 4>> ByOpcode;
+
+public:
+  explicit RuleSet(LLVMContext &Ctx);
+
+  ArrayRef<Rule*> lookup(unsigned Opcode) const {
+    auto It = ByOpcode.find(Opcode);
+    if (It == ByOpcode.end())
+      return {};
+    return It->second;
+  }
+
+  bool empty() const { return Rules.empty(); }
+};
+
+RuleSet::RuleSet(LLVMContext &Ctx) {
+  for (auto *Texts : {&Table, &fileRules()}) {
+    for (auto &T : *Texts) {
+      auto R = loadRule(T, Ctx);
+      if (!R) {
+        ++NumBadRules;
+        continue;
+      }
+      ++NumRules;
+      ByOpcode[R->Root->getOpcode()].push_back(R.get());
+      Rules.push_back(std::move(R));
+    }
+  }
+
+  // the larger patterns first, they are more specific
+  for (auto &[Opcode, Rs] : ByOpcode) {
+    std::stable_sort(Rs.begin(), Rs.end(), [](Rule *A, Rule *B) {
+      if (A->Size != B->Size)
+        return A->Size > B->Size;
+      return A->CostBefore - A->CostAfter > B->CostBefore - B->CostAfter;
+    });
+  }
+}
+
+bool applyRules(Function &F, const RuleSet &RS) {
+  vector<Instruction*> Roots;
+  for (auto &BB : F) {
+    for (auto &I : BB) {
+      if (!I.getType()->isVoidTy() && !isa<PHINode>(&I))
+        Roots.push_back(&I);
+    }
+  }
+
+  bool Changed = false;
+  for (auto *I : Roots) {
+    for (auto *R : RS.lookup(I->getOpcode())) {
+      Matcher Match;
+      if (!Match.match(R->Root, I))
+        continue;
+
+      debug() << "[rules] " << F.getName() << ": " << *I << "\n"
+              << "[rules]   matches " << *R->Rewrite << "\n";
+      ValueToValueMapTy VMap;
+      unordered_set<llvm::Function*> IntrinDecls;
+      auto *V = LLVMGen(I, IntrinDecls).codeGen(R->Rewrite,
+                                                Match.getValueMap(VMap));
+      V = llvm::IRBuilder<>(I).CreateBitCast(V, I->getType());
+      I->replaceAllUsesWith(V);
+      ++NumRuleRewrites;
+      Changed = true;
+      break;
+    }
+  }
+  return Changed;
+}
+
+struct MinotaurRulesPass : PassInfoMixin<MinotaurRulesPass> {
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &) {
+    if (Table.empty() && fileRules().empty())
+      return PreservedAnalyses::all();
+
+    // the patterns live in the context of M, so that types and constants
+    // compare by pointer
+    RuleSet RS(M.getContext());
+    if (RS.empty())
+      return PreservedAnalyses::all();
+
+    bool Changed = false;
+    for (auto &F : M) {
+      if (F.isDeclaration() || !applyRules(F, RS))
+        continue;
+      eliminate_dead_code(F);
+      F.removeFnAttr("min-legal-vector-width");
+      Changed = true;
+    }
+    return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+  }
+};
+
+} // end anonymous namespace
+
+extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "Minotaur Rules", "",
+          [](llvm::PassBuilder &PB) {
+            PB.registerPipelineParsingCallback(
+                [](llvm::StringRef Name, llvm::ModulePassManager &MPM,
+                   llvm::ArrayRef<llvm::PassBuilder::PipelineElement>) {
+                  if (Name != "minotaur-rules")
+                    return false;
+
+                  MPM.addPass(MinotaurRulesPass());
+                  return true;
+                });
+            // with -fpass-plugin, the rules run at the end of the pipeline
+            PB.registerOptimizerLastEPCallback(
+                [](llvm::ModulePassManager &MPM, llvm::OptimizationLevel,
+                   llvm::ThinOrFullLTOPhase) {
+                  MPM.addPass(MinotaurRulesPass());
+                });
+          }};
+}
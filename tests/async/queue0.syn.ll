@@ -0,0 +1,14 @@
+; TEST-ARGS: -minotaur-async -minotaur-debug-slicer=true
+; RUNS: 2
+; CHECK: [online] cache matched, but slice is still queued for synthesis
+; CHECK-NOT: [online] slice queued for out-of-line synthesis
+
+; the first run queues the slice, the second finds it pending and leaves
+; the function alone
+
+define i32 @queue_0(i32 %x) {
+entry:
+  %a = add i32 %x, 40961
+  %b = mul i32 %a, 77
+  ret i32 %b
+}
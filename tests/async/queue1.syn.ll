@@ -0,0 +1,15 @@
+; TEST-ARGS: -minotaur-async -minotaur-pending-expiry=0 -minotaur-debug-slicer=true
+; RUNS: 2
+; CHECK: [online] cache matched, but slice has been queued for
+; CHECK: [online] slice queued for out-of-line synthesis
+; CHECK-NOT: still queued for synthesis
+
+; with no expiry, the pending slice of the first run is a miss in the second,
+; which queues it again
+
+define i32 @queue_1(i32 %x) {
+entry:
+  %a = add i32 %x, 40963
+  %b = mul i32 %a, 79
+  ret i32 %b
+}
@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+# Distributed under the MIT license that can be found in the LICENSE file.
+
+# Runs a fixed corpus through opt-minotaur.sh and records, per input, the
+# total time, the time to the first rewrite, the number of slices,
+# candidates and SMT queries, the peak RSS and the cost of the rewrites.
+# The results are compared against a stored baseline.
+
+import argparse, glob, json, os, re, shutil, subprocess, sys, tempfile, time
+
+regex_args = re.compile(r"(?:;|//)\s*TEST-ARGS:(.*)")
+
+def read_corpus(path):
+  root = os.path.dirname(os.path.dirname(os.path.abspath(path)))
+  tests = []
+  with open(path) as f:
+    for line in f:
+      line = line.split('#')[0].strip()
+      if line:
+        tests.append(os.path.join(root, line))
+  return tests
+
+def first_solution(trace):
+  # the end of the first slice span that produced a rewrite, in seconds
+  try:
+    with open(trace) as f:
+      events = json.load(f)['traceEvents']
+  except (OSError, ValueError, KeyError):
+    return None
+  ends = [(e['ts'] + e['dur']) / 1e6 for e in events
+          if e['name'] == 'slice' and
+             e.get('args', {}).get('result', '').endswith('rewrite')]
+  return min(ends) if ends else None
+
+def run(opt, test, cache, timeout):
+  work = tempfile.mkdtemp(prefix='minotaur-bench-')
+  trace = os.path.join(work, 'trace.json')
+  cmd = [opt, '-S', '-o', os.devnull,
+         '-minotaur-report-dir=' + work,
+         '-minotaur-trace-file=' + trace]
+  if cache == 'cold':
+    cmd.append('-minotaur-force-infer=true')
+
+  with open(test) as f:
+    m = regex_args.search(f.read())
+  if m:
+    cmd += m.group(1).split()
+  cmd.append(test)
+
+  start = time.monotonic()
+  p = subprocess.Popen(cmd, stdout=subprocess.DEVNULL,
+                       stderr=subprocess.DEVNULL)
+  while True:
+    pid, status, rusage = os.wait4(p.pid, os.WNOHANG)
+    if pid:
+      break
+    if time.monotonic() - start > timeout:
+      p.kill()
+      pid, status, rusage = os.wait4(p.pid, 0)
+      status = None
+      break
+    time.sleep(0.01)
+  # already reaped by wait4
+  p.returncode = 0
+  total = time.monotonic() - start
+
+  result = {
+    'status': 'timeout' if status is None else
+              ('ok' if os.waitstatus_to_exitcode(status) == 0 else 'error'),
+    'total': total,
+    # ru_maxrss is in KB on Linux and in bytes on macOS
+    'maxrss_kb': rusage.ru_maxrss // (1024 if sys.platform == 'darwin'
+                                      else 1),
+    'first_solution': first_solution(trace),
+  }
+
+  reports = glob.glob(os.path.join(work, 'minotaur_stats_*.json'))
+  counters = {}
+  for r in reports:
+    with open(r) as f:
+      for k, v in json.load(f)['counters'].items():
+        counters[k] = counters.get(k, 0) + v
+  for k in ('slices', 'candidates', 'smt-queries', 'rewrites',
+            'cost-before', 'cost-after'):
+    result[k] = counters.get(k, 0)
+
+  shutil.rmtree(work, ignore_errors=True)
+  return result
+
+def regressions(name, cur, base, tolerance):
+  found = []
+  def slower(key, slack):
+    a, b = cur.get(key), base.get(key)
+    if a is not None and b is not None and a > b * (1 + tolerance) + slack:
+      found.append('%s: %s %.2fs -> %.2fs' % (name, key, b, a))
+  slower('total', 1.0)
+  slower('first_solution', 1.0)
+  if base['rewrites'] > cur['rewrites']:
+    found.append('%s: rewrites %d -> %d' %
+                 (name, base['rewrites'], cur['rewrites']))
+  if cur['rewrites'] and base['rewrites'] and \
+     cur['cost-after'] > base['cost-after']:
+    found.append('%s: cost after %d -> %d' %
+                 (name, base['cost-after'], cur['cost-after']))
+  if cur['maxrss_kb'] > base['maxrss_kb'] * (1 + tolerance) + 64 * 1024:
+    found.append('%s: peak rss %dKB -> %dKB' %
+                 (name, base['maxrss_kb'], cur['maxrss_kb']))
+  return found
+
+def main():
+  here = os.path.dirname(os.path.abspath(__file__))
+  ap = argparse.ArgumentParser(description='Minotaur synthesis benchmark')
+  ap.add_argument('--opt', default='./opt-minotaur.sh',
+                  help='opt wrapper that loads the minotaur pass')
+  ap.add_argument('--corpus', default=os.path.join(here, 'corpus.txt'))
+  ap.add_argument('--baseline', default=os.path.join(here, 'baseline.json'))
+  ap.add_argument('--cache', choices=['cold', 'warm'], default='cold',
+                  help='cold forces synthesis, warm reads the redis cache')
+  ap.add_argument('--timeout', type=float, default=600,
+                  help='seconds per input')
+  ap.add_argument('--tolerance', type=float, default=0.2,
+                  help='relative slowdown tolerated before flagging')
+  ap.add_argument('--output', help='write the results to this file')
+  ap.add_argument('--update-baseline', action='store_true')
+  args = ap.parse_args()
+
+  if not os.path.isfile(args.opt):
+    sys.exit('cannot find ' + args.opt + ', run from the build directory')
+
+  results = {}
+  root = os.path.dirname(here)
+  for test in read_corpus(args.corpus):
+    name = os.path.relpath(test, root)
+    r = run(args.opt, test, args.cache, args.timeout)
+    results[name] = r
+    fs = r['first_solution']
+    print('%-45s %-7s %7.2fs  first %7s  slices %3d  cand %5d  smt %5d  '
+          'rss %6dKB  cost %d -> %d' %
+          (name, r['status'], r['total'],
+           '-' if fs is None else '%.2fs' % fs, r['slices'],
+           r['candidates'], r['smt-queries'], r['maxrss_kb'],
+           r['cost-before'], r['cost-after']))
+    sys.stdout.flush()
+
+  report = {'cache': args.cache, 'results': results}
+  if args.output:
+    with open(args.output, 'w') as f:
+      json.dump(report, f, indent=2, sort_keys=True)
+
+  if args.update_baseline:
+    with open(args.baseline, 'w') as f:
+      json.dump(report, f, indent=2, sort_keys=True)
+    print('baseline written to ' + args.baseline)
+    return 0
+
+  if not os.path.isfile(args.baseline):
+    print('no baseline to compare against, use --update-baseline')
+    return 0
+
+  with open(args.baseline) as f:
+    baseline = json.load(f)
+  if baseline.get('cache') != args.cache:
+    print('baseline was recorded with a %s cache, not comparing' %
+          baseline.get('cache'))
+    return 0
+
+  found = []
+  for name, r in results.items():
+    b = baseline['results'].get(name)
+    if b is not None:
+      found += regressions(name, r, b, args.tolerance)
+
+  for f in found:
+    print('REGRESSION ' + f)
+  print('%d inputs, %d regressions' % (len(results), len(found)))
+  return 1 if found else 0
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,7 @@
+; CHECK: extractelement <8 x i16> %1, i16 7
+define i16 @extract_high_half_of_last_lane(<4 x i32> %x) {
+  %e = extractelement <4 x i32> %x, i32 3
+  %s = lshr i32 %e, 16
+  %t = trunc i32 %s to i16
+  ret i16 %t
+}
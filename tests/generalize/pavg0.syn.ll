@@ -0,0 +1,31 @@
+; TEST-ARGS: -minotaur-generalize -minotaur-force-infer=true -minotaur-show-stats
+; RUNS: 2
+; CHECK: call <8 x i16> @llvm.x86.sse2.pavg.w
+; CHECK: call <16 x i16> @llvm.x86.avx2.pavg.w
+; CHECK: [stats] #shape-hits =
+; CHECK-NOT: [stats] #shape-hits = 0
+
+; the two averages have the same shape at different widths; by the second
+; run the shape is known, and both are solved with its skeleton
+
+define <8 x i16> @pavg_128(<8 x i16> %a, <8 x i16> %b) {
+entry:
+  %za = zext <8 x i16> %a to <8 x i17>
+  %zb = zext <8 x i16> %b to <8 x i17>
+  %add = add <8 x i17> %za, %zb
+  %add_1 = add <8 x i17> %add, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %sh = lshr <8 x i17> %add_1, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %ret = trunc <8 x i17> %sh to <8 x i16>
+  ret <8 x i16> %ret
+}
+
+define <16 x i16> @pavg_256(<16 x i16> %a, <16 x i16> %b) {
+entry:
+  %za = zext <16 x i16> %a to <16 x i17>
+  %zb = zext <16 x i16> %b to <16 x i17>
+  %add = add <16 x i17> %za, %zb
+  %add_1 = add <16 x i17> %add, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %sh = lshr <16 x i17> %add_1, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %ret = trunc <16 x i17> %sh to <16 x i16>
+  ret <16 x i16> %ret
+}
@@ -0,0 +1,14 @@
+; TEST-ARGS: -minotaur-force-infer=true -minotaur-show-stats
+; CHECK: extractelement <4 x i32> %v
+; CHECK: [stats] #screened =
+; CHECK-NOT: [stats] #screened = 0
+
+; the lane of the extractelement sketch is a hole with four values, the
+; concrete tests rule out the three that do not pick the last lane
+
+define i32 @extract_reversed(<4 x i32> %v) {
+entry:
+  %s = shufflevector <4 x i32> %v, <4 x i32> poison, <4 x i32> <i32 3, i32 2, i32 1, i32 0>
+  %e = extractelement <4 x i32> %s, i64 0
+  ret i32 %e
+}
@@ -0,0 +1,17 @@
+; TEST-ARGS: -minotaur-reduced-width=2 -minotaur-force-infer=true -minotaur-debug-enumerator=true
+; CHECK: [enumerator] verifying on 8 lanes first
+; CHECK: call <16 x i16> @llvm.x86.avx2.pavg.w
+
+; the pavg candidate is lane parallel, so it is verified on as few lanes as
+; pavg comes in first, eight for at least two, and then on all sixteen
+
+define <16 x i16> @lanes_pavg_0(<16 x i16> %a, <16 x i16> %b) {
+entry:
+  %za = zext <16 x i16> %a to <16 x i17>
+  %zb = zext <16 x i16> %b to <16 x i17>
+  %add = add <16 x i17> %za, %zb
+  %add_1 = add <16 x i17> %add, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %sh = lshr <16 x i17> %add_1, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %ret = trunc <16 x i17> %sh to <16 x i16>
+  ret <16 x i16> %ret
+}
@@ -4,7 +4,7 @@
 import lit.TestRunner
 import lit.util
 from .base import TestFormat
-import os, re, signal, string, subprocess
+import os, re, shutil, signal, string, subprocess, tempfile
 
 ok_string = 'Transformation seems to be correct!'
 
@@ -52,6 +52,7 @@ class MinotaurTest(TestFormat):
     self.regex_args = re.compile(r"(?:;|//)\s*TEST-ARGS:(.*)")
     self.regex_check = re.compile(r"(?:;|//)\s*CHECK:(.*)")
     self.regex_check_not = re.compile(r"(?:;|//)\s*CHECK-NOT:(.*)")
+    self.regex_runs = re.compile(r"(?:;|//)\s*RUNS:\s*(\d+)")
     self.regex_errs_out = re.compile("ERROR:.*")
 
   def getTestsInDirectory(self, testSuite, path_in_suite,
@@ -61,7 +62,7 @@ class MinotaurTest(TestFormat):
       filepath = os.path.join(source_path, filename)
       if not filename.startswith('.') and \
           not os.path.isdir(filepath) and \
-          filename.endswith('.syn.ll'):
+          (filename.endswith('.syn.ll') or filename.endswith('.rules.ll')):
         yield lit.Test.Test(testSuite, path_in_suite + (filename,), localConfig)
 
 
@@ -73,17 +74,33 @@ class MinotaurTest(TestFormat):
       cmd = ['./opt-minotaur.sh', '-S']
       if not os.path.isfile('opt-minotaur.sh'):
         return lit.Test.UNSUPPORTED, ''
+    else:
+      cmd = ['./opt-rules.sh', '-S']
+      if not os.path.isfile('opt-rules.sh'):
+        return lit.Test.UNSUPPORTED, ''
 
     input = readFile(test)
 
+    # %t is a fresh directory kept across the runs of the test
+    tmp = tempfile.mkdtemp(prefix='minotaur-test-')
+
     # add test-specific args
     m = self.regex_args.search(input)
     if m != None:
-      cmd += m.group(1).split()
+      # %S is the directory of the test
+      cmd += [a.replace('%S', os.path.dirname(test)).replace('%t', tmp)
+              for a in m.group(1).split()]
 
     cmd.append(test)
 
-    out, err, exitCode = executeCommand(cmd)
+    # tests of the caches run the same command several times, only the
+    # output of the last run is checked
+    runs = self.regex_runs.search(input)
+    try:
+      for _ in range(int(runs.group(1)) if runs else 1):
+        out, err, exitCode = executeCommand(cmd)
+    finally:
+      shutil.rmtree(tmp, ignore_errors=True)
     output = out + err
 
     xfail = self.regex_xfail.search(input)
@@ -93,13 +110,16 @@ class MinotaurTest(TestFormat):
     if is_timeout(output):
       return lit.Test.PASS, ''
 
+    # every CHECK must be in the output, and no CHECK-NOT
     chk = self.regex_check.search(input)
-    if chk != None and output.find(chk.group(1).strip()) == -1:
-      return lit.Test.FAIL, output
+    for m in self.regex_check.finditer(input):
+      if output.find(m.group(1).strip()) == -1:
+        return lit.Test.FAIL, output
 
     chk_not = self.regex_check_not.search(input)
-    if chk_not != None and output.find(chk_not.group(1).strip()) != -1:
-      return lit.Test.FAIL, output
+    for m in self.regex_check_not.finditer(input):
+      if output.find(m.group(1).strip()) != -1:
+        return lit.Test.FAIL, output
 
     expect_err = self.regex_errs.search(input)
     if expect_err is None and xfail is None and chk is None and chk_not is None:
@@ -0,0 +1,25 @@
+; TEST-ARGS: -minotaur-debug-slicer=true
+; CHECK: [slicer] hoisting  %nota = xor i32 %a, -1 into the entry block
+; CHECK: %acc.next = add i32 %acc, %0
+
+; %nota is computed before the loop, it is hoisted into the slice of %s so
+; that (~a & i) | a simplifies to i | a
+
+define i32 @hoist0(i32 %a, i32 %n) {
+entry:
+  %nota = xor i32 %a, -1
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %t = and i32 %nota, %i
+  %s = or i32 %t, %a
+  %acc.next = add i32 %acc, %s
+  %i.next = add i32 %i, 1
+  %c = icmp ult i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %acc.next
+}
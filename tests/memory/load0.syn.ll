@@ -0,0 +1,7 @@
+; CHECK: ret i32 0
+define i32 @src(ptr %p) {
+  %a = load i32, ptr %p
+  %b = load i32, ptr %p
+  %c = sub i32 %a, %b
+  ret i32 %c
+}
@@ -0,0 +1,9 @@
+; CHECK-NOT: ret i32 0
+; the store may change what %b reads, so %a is not harvested with it
+define i32 @src(ptr %p) {
+  %a = load i32, ptr %p
+  store i32 1, ptr %p
+  %b = load i32, ptr %p
+  %c = sub i32 %a, %b
+  ret i32 %c
+}
@@ -0,0 +1,15 @@
+; TEST-ARGS: -minotaur-rules-file=%S/pavg0.inc
+; CHECK: call <16 x i16> @llvm.x86.avx2.pavg.w(<16 x i16> %y, <16 x i16> %x)
+
+; the rule matches whatever the operands are named, and binds them in order
+
+define <16 x i16> @rules_pavg_0(<16 x i16> %x, <16 x i16> %y)  {
+entry:
+  %zy = zext <16 x i16> %y to <16 x i17>
+  %zx = zext <16 x i16> %x to <16 x i17>
+  %add = add <16 x i17> %zy, %zx
+  %add_1 = add <16 x i17> %add, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %sh = lshr <16 x i17> %add_1, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %ret = trunc <16 x i17> %sh to <16 x i16>
+  ret <16 x i16> %ret
+}
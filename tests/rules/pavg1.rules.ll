@@ -0,0 +1,16 @@
+; TEST-ARGS: -minotaur-rules-file=%S/pavg1.inc
+; CHECK: call <16 x i16> @llvm.x86.avx2.pavg.w(<16 x i16> %a, <16 x i16> %b)
+
+; pavg1.inc is the table cache-rulegen writes for the slice of syn_pavg1,
+; with its sink block and the unused i16 block selector of the slicer
+
+define <16 x i16> @rules_pavg_1(<16 x i16> %a, <16 x i16> %b)  {
+entry:
+  %za = zext <16 x i16> %a to <16 x i17>
+  %zb = zext <16 x i16> %b to <16 x i17>
+  %add = add <16 x i17> %za, %zb
+  %add_1 = add <16 x i17> %add, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %sh = lshr <16 x i17> %add_1, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %ret = trunc <16 x i17> %sh to <16 x i16>
+  ret <16 x i16> %ret
+}
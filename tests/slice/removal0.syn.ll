@@ -0,0 +1,16 @@
+; TEST-ARGS: -minotaur-removal-slice -minotaur-debug-slicer=true
+; CHECK: [removal-slicer] 6 instructions are harvested
+; CHECK: call <16 x i16> @llvm.x86.avx2.pavg.w
+
+; every instruction of the average dies with it, so all six are in the slice
+
+define <16 x i16> @removal_pavg_0(<16 x i16> %a, <16 x i16> %b)  {
+entry:
+  %za = zext <16 x i16> %a to <16 x i17>
+  %zb = zext <16 x i16> %b to <16 x i17>
+  %add = add <16 x i17> %za, %zb
+  %add_1 = add <16 x i17> %add, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %sh = lshr <16 x i17> %add_1, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %ret = trunc <16 x i17> %sh to <16 x i16>
+  ret <16 x i16> %ret
+}
@@ -0,0 +1,19 @@
+; TEST-ARGS: -minotaur-smt-cache-dir=%t -minotaur-force-infer=true -minotaur-show-stats
+; RUNS: 2
+; CHECK: call <16 x i16> @llvm.x86.avx2.pavg.w
+; CHECK: [stats] #smt-cache-hits =
+; CHECK-NOT: [stats] #smt-cache-hits = 0
+
+; the first run fills the query cache, the second run asks the same queries
+; and gets them from the cache
+
+define <16 x i16> @smt_cache_pavg_0(<16 x i16> %a, <16 x i16> %b) {
+entry:
+  %za = zext <16 x i16> %a to <16 x i17>
+  %zb = zext <16 x i16> %b to <16 x i17>
+  %add = add <16 x i17> %za, %zb
+  %add_1 = add <16 x i17> %add, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %sh = lshr <16 x i17> %add_1, <i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1, i17 1>
+  %ret = trunc <16 x i17> %sh to <16 x i16>
+  ret <16 x i16> %ret
+}
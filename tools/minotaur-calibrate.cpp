@@ -0,0 +1,265 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "codegen.h"
+#include "cost.h"
+#include "parse.h"
+#include "utils.h"
+
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include "hiredis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+using namespace llvm;
+using namespace minotaur;
+
+static cl::OptionCategory minotaur_calibrate("minotaur-calibrate options");
+
+static cl::opt<string> opt_output(
+    "o", cl::desc("write the cost table to the file"),
+    cl::cat(minotaur_calibrate), cl::Required, cl::value_desc("filename"));
+
+static cl::opt<unsigned> opt_redis_port(
+    "redis-port", cl::desc("redis port number"),
+    cl::cat(minotaur_calibrate), cl::init(6379));
+
+static cl::opt<bool> opt_mca(
+    "mca",
+    cl::desc("measure the slices and their rewrites with llvm-mca on this "
+             "machine instead of using the costs in the cache"),
+    cl::cat(minotaur_calibrate), cl::init(false));
+
+static cl::opt<unsigned> opt_scale(
+    "scale", cl::desc("weights are the fitted costs times this"),
+    cl::cat(minotaur_calibrate), cl::init(10));
+
+// the instructions of a function by cost key
+using Counts = map<unsigned, double>;
+
+struct Sample {
+  Counts Before, After;
+  double CostBefore, CostAfter;
+  // the built-in approximate costs
+  unsigned ApproxBefore, ApproxAfter;
+};
+
+static map<string, unsigned> Keys;
+
+static Counts countKeys(Function &F) {
+  Counts C;
+  for (auto &BB : F) {
+    for (auto &I : BB) {
+      auto Key = get_cost_key(I);
+      if (!Key.empty())
+        C[Keys.try_emplace(Key, Keys.size()).first->second] += 1;
+    }
+  }
+  return C;
+}
+
+static double cost(const Counts &C, const vector<double> &W) {
+  double Sum = 0;
+  for (auto [K, N] : C)
+    Sum += N * W[K];
+  return Sum;
+}
+
+static Function *findSlice(Module &M) {
+  for (auto &F : M) {
+    if (!F.isDeclaration())
+      return &F;
+  }
+  return nullptr;
+}
+
+// the slicer always returns the root of the slice
+static Instruction *findRoot(Function &F) {
+  for (auto &BB : F) {
+    if (auto *RI = dyn_cast<ReturnInst>(BB.getTerminator()))
+      return dyn_cast_or_null<Instruction>(RI->getReturnValue());
+  }
+  return nullptr;
+}
+
+static bool getCost(const string &Key, const char *Field, double &Cost,
+                    redisContext *ctx) {
+  string Value;
+  if (!hGetField(Key.c_str(), Key.size(), Field, Value, ctx))
+    return false;
+  Cost = atof(Value.c_str());
+  return Cost > 0;
+}
+
+static bool sample(const string &Key, const string &Rewrite, Sample &S,
+                   redisContext *ctx) {
+  if (!opt_mca && (!getCost(Key, "costbefore", S.CostBefore, ctx) ||
+                   !getCost(Key, "costafter", S.CostAfter, ctx)))
+    return false;
+
+  LLVMContext Context;
+  SMDiagnostic Diag;
+  auto M = parseAssemblyString(Key, Diag, Context);
+  Function *F = M ? findSlice(*M) : nullptr;
+  Instruction *Root = F ? findRoot(*F) : nullptr;
+  if (!Root)
+    return false;
+
+  parse::Parser P(*F);
+  auto RHSs = P.parse(*F, Rewrite);
+  if (RHSs.empty())
+    return false;
+
+  if (opt_mca)
+    S.CostBefore = get_machine_cost(F);
+  S.Before = countKeys(*F);
+  S.ApproxBefore = get_approx_cost(F);
+
+  unordered_set<llvm::Function*> IntrinsicDecls;
+  ValueToValueMapTy VMap;
+  auto *V = LLVMGen(Root, IntrinsicDecls).codeGen(RHSs[0].I, VMap);
+  V = IRBuilder<>(Root).CreateBitCast(V, Root->getType());
+  Root->replaceAllUsesWith(V);
+  eliminate_dead_code(*F);
+
+  if (opt_mca)
+    S.CostAfter = get_machine_cost(F);
+  S.After = countKeys(*F);
+  S.ApproxAfter = get_approx_cost(F);
+  return S.CostBefore > 0 && S.CostAfter > 0;
+}
+
+// Nonnegative least squares over the costs of the slices and of their
+// rewrites, by cyclic coordinate descent on the normal equations
+static vector<double> fit(const vector<Sample> &Samples, unsigned N) {
+  vector<vector<double>> G(N, vector<double>(N, 0));
+  vector<double> H(N, 0);
+  auto addRow = [&](const Counts &C, double Cost) {
+    for (auto [I, NI] : C) {
+      H[I] += NI * Cost;
+      for (auto [J, NJ] : C)
+        G[I][J] += NI * NJ;
+    }
+  };
+  for (auto &S : Samples) {
+    addRow(S.Before, S.CostBefore);
+    addRow(S.After, S.CostAfter);
+  }
+
+  vector<double> W(N, 0), Grad(N);
+  for (unsigned I = 0; I < N; ++I)
+    Grad[I] = -H[I];
+  for (unsigned Sweep = 0; Sweep < 10000; ++Sweep) {
+    double MaxStep = 0;
+    for (unsigned J = 0; J < N; ++J) {
+      if (G[J][J] == 0)
+        continue;
+      double New = max(0.0, W[J] - Grad[J] / G[J][J]);
+      double Step = New - W[J];
+      if (Step == 0)
+        continue;
+      W[J] = New;
+      for (unsigned I = 0; I < N; ++I)
+        Grad[I] += G[I][J] * Step;
+      MaxStep = max(MaxStep, fabs(Step));
+    }
+    if (MaxStep < 1e-9)
+      break;
+  }
+  return W;
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal(argv[0]);
+  PrettyStackTraceProgram X(argc, argv);
+
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Minotaur approximate cost model calibration\n");
+
+  redisContext *ctx = redisConnect("127.0.0.1", opt_redis_port);
+  if (!ctx || ctx->err)
+    report_fatal_error("[calibrate] cannot connect to redis");
+
+  vector<string> Slices;
+  hScanSlices([&](StringRef K) {
+    Slices.push_back(K.str());
+    return true;
+  }, ctx);
+
+  vector<Sample> Samples;
+  for (auto &Key : Slices) {
+    string Rewrite;
+    if (!hGet(Key.c_str(), Key.size(), Rewrite, ctx) ||
+        Rewrite == "<no-sol>" || Rewrite == "<pending>")
+      continue;
+    Sample S;
+    if (sample(Key, Rewrite, S, ctx))
+      Samples.push_back(std::move(S));
+  }
+  redisFree(ctx);
+
+  if (Samples.empty()) {
+    errs() << "[calibrate] no rewrites with costs in the cache\n";
+    return 1;
+  }
+
+  auto W = fit(Samples, Keys.size());
+
+  // how often the models agree with the measured costs on whether a
+  // rewrite pays off
+  double Residual = 0;
+  unsigned Fitted = 0, Builtin = 0;
+  for (auto &S : Samples) {
+    double Before = cost(S.Before, W), After = cost(S.After, W);
+    Residual += pow(Before - S.CostBefore, 2) + pow(After - S.CostAfter, 2);
+    bool Pays = S.CostAfter < S.CostBefore;
+    Fitted += (After < Before) == Pays;
+    Builtin += (S.ApproxAfter < S.ApproxBefore) == Pays;
+  }
+  Residual = sqrt(Residual / (2 * Samples.size()));
+
+  vector<unsigned> Weights;
+  for (auto [Key, I] : Keys)
+    Weights.push_back(lround(W[I] * opt_scale));
+  vector<unsigned> Sorted(Weights);
+  sort(Sorted);
+  unsigned Default = max(1u, Sorted[Sorted.size() / 2]);
+
+  error_code EC;
+  raw_fd_ostream OS(opt_output, EC, sys::fs::OF_Text);
+  if (EC) {
+    errs() << "[calibrate] cannot write " << opt_output << ": "
+           << EC.message() << "\n";
+    return 1;
+  }
+  OS << "# fitted by minotaur-calibrate on " << Samples.size()
+     << " rewrites, scale " << opt_scale << "\n";
+  unsigned K = 0;
+  for (auto &[Key, I] : Keys)
+    OS << Key << " " << Weights[K++] << "\n";
+  OS << "* " << Default << "\n";
+
+  outs() << "[calibrate] " << Samples.size() << " rewrites, " << Keys.size()
+         << " keys, rms residual " << Residual << "\n"
+         << "[calibrate] the rewrite pays off as predicted: " << Fitted
+         << " fitted, " << Builtin << " built-in\n";
+  return 0;
+}
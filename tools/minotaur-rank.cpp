@@ -0,0 +1,119 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "parse.h"
+#include "ranking.h"
+#include "utils.h"
+
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "hiredis.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace llvm;
+using namespace minotaur;
+
+static cl::OptionCategory minotaur_rank("minotaur-rank options");
+
+static cl::opt<string> opt_output(
+    "o", cl::desc("write the ranking model to the file"),
+    cl::cat(minotaur_rank), cl::Required, cl::value_desc("filename"));
+
+static cl::opt<unsigned> opt_redis_port(
+    "redis-port", cl::desc("redis port number"),
+    cl::cat(minotaur_rank), cl::init(6379));
+
+static Function *findSlice(Module &M) {
+  for (auto &F : M) {
+    if (!F.isDeclaration())
+      return &F;
+  }
+  return nullptr;
+}
+
+// the slicer always returns the root of the slice
+static Instruction *findRoot(Function &F) {
+  for (auto &BB : F) {
+    if (auto *RI = dyn_cast<ReturnInst>(BB.getTerminator()))
+      return dyn_cast_or_null<Instruction>(RI->getReturnValue());
+  }
+  return nullptr;
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal(argv[0]);
+  PrettyStackTraceProgram X(argc, argv);
+
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Minotaur sketch ranking model trainer\n");
+
+  redisContext *ctx = redisConnect("127.0.0.1", opt_redis_port);
+  if (!ctx || ctx->err)
+    report_fatal_error("[rank] cannot connect to redis");
+
+  vector<string> Keys;
+  hScanSlices([&](StringRef K) {
+    Keys.push_back(K.str());
+    return true;
+  }, ctx);
+
+  RankModel Model;
+  unsigned Solved = 0, Unsolved = 0;
+  for (auto &Key : Keys) {
+    string Rewrite;
+    if (!hGet(Key.c_str(), Key.size(), Rewrite, ctx) || Rewrite == "<pending>")
+      continue;
+    bool HaveRewrite = Rewrite != "<no-sol>";
+    if (!HaveRewrite) {
+      NoSolution NS;
+      hGetNoSolution(Key.c_str(), Key.size(), NS, ctx);
+      if (NS.Reason == "malformed")
+        continue;
+    }
+
+    LLVMContext Context;
+    SMDiagnostic Diag;
+    auto M = parseAssemblyString(Key, Diag, Context);
+    Function *F = M ? findSlice(*M) : nullptr;
+    if (!F || !findRoot(*F))
+      continue;
+
+    set<string> Families;
+    if (HaveRewrite) {
+      parse::Parser P(*F);
+      auto RHSs = P.parse(*F, Rewrite);
+      if (RHSs.empty())
+        continue;
+      Families = sketchFamilies(RHSs[0].I);
+      ++Solved;
+    } else {
+      ++Unsolved;
+    }
+    Model.add(sliceFeatures(*F), Families);
+  }
+  redisFree(ctx);
+
+  error_code EC;
+  raw_fd_ostream OS(opt_output, EC, sys::fs::OF_Text);
+  if (EC) {
+    errs() << "[rank] cannot write " << opt_output << ": " << EC.message()
+           << "\n";
+    return 1;
+  }
+  Model.write(OS);
+  outs() << "[rank] " << Solved << " solved and " << Unsolved
+         << " unsolved slices\n";
+  return 0;
+}
@@ -0,0 +1,233 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "config.h"
+#include "enumerator.h"
+#include "trace.h"
+#include "utils.h"
+
+#include "smt/smt.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "hiredis.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace llvm;
+using namespace minotaur;
+
+static cl::OptionCategory minotaur_replay("minotaur-replay options");
+
+static cl::list<string> opt_inputs(
+    cl::Positional, cl::desc("<slice files or directories>"),
+    cl::cat(minotaur_replay));
+
+static cl::list<string> opt_keys(
+    "key", cl::desc("replay the cached slice whose hash starts with this"),
+    cl::cat(minotaur_replay), cl::value_desc("hash"));
+
+static cl::opt<unsigned> opt_redis_port(
+    "redis-port", cl::desc("redis port number"),
+    cl::cat(minotaur_replay), cl::init(6379));
+
+static cl::opt<unsigned> opt_seed(
+    "seed", cl::desc("random seed of the SMT solver"),
+    cl::cat(minotaur_replay), cl::init(0));
+
+static cl::opt<unsigned> opt_smt_to(
+    "minotaur-query-to", cl::desc("minotaur: timeout for SMT queries"),
+    cl::cat(minotaur_replay), cl::init(60), cl::value_desc("s"));
+
+static cl::opt<unsigned> opt_smt_fast_to(
+    "minotaur-query-fast-to",
+    cl::desc("minotaur: verify candidates with this timeout first, and "
+             "retry the ones that time out with the full timeout"),
+    cl::cat(minotaur_replay), cl::init(0), cl::value_desc("ms"));
+
+static cl::opt<string> opt_smt_cache_dir(
+    "minotaur-smt-cache-dir",
+    cl::desc("minotaur: remember the verdicts of SMT queries in this "
+             "directory"),
+    cl::cat(minotaur_replay), cl::value_desc("dir"));
+
+static cl::opt<unsigned> opt_reduced_width(
+    "minotaur-reduced-width",
+    cl::desc("minotaur: verify lane parallel candidates on this many lanes "
+             "first, and only the good ones at full width"),
+    cl::cat(minotaur_replay), cl::init(0), cl::value_desc("lanes"));
+
+static cl::opt<unsigned> opt_slice_to(
+    "minotaur-slice-to", cl::desc("minotaur: timeout per slice"),
+    cl::cat(minotaur_replay), cl::init(300), cl::value_desc("s"));
+
+static cl::opt<bool> opt_ignore_mca(
+    "minotaur-ignore-machine-cost",
+    cl::desc("minotaur: ignore llvm-mca cost model"),
+    cl::cat(minotaur_replay), cl::init(false));
+
+static cl::opt<string> opt_trace_file(
+    "trace-file", cl::desc("write Chrome trace events to the file"),
+    cl::cat(minotaur_replay), cl::value_desc("filename"));
+
+static cl::opt<bool> opt_debug(
+    "dbg", cl::desc("minotaur: print enumerator debugging info"),
+    cl::cat(minotaur_replay), cl::init(false));
+
+static Function *findSlice(Module &M) {
+  for (auto &F : M) {
+    if (!F.isDeclaration())
+      return &F;
+  }
+  return nullptr;
+}
+
+// the slicer always returns the root of the slice
+static Instruction *findRoot(Function &F) {
+  for (auto &BB : F) {
+    if (auto *RI = dyn_cast<ReturnInst>(BB.getTerminator()))
+      return dyn_cast_or_null<Instruction>(RI->getReturnValue());
+  }
+  return nullptr;
+}
+
+static void collect(StringRef Path, vector<string> &Files) {
+  if (!sys::fs::is_directory(Path)) {
+    Files.push_back(Path.str());
+    return;
+  }
+  // cache-dump -tofiles writes dump_<n>.src.ll
+  vector<string> Found;
+  error_code EC;
+  for (sys::fs::directory_iterator I(Path, EC), E; I != E && !EC;
+       I.increment(EC)) {
+    if (StringRef(I->path()).ends_with(".ll"))
+      Found.push_back(I->path());
+  }
+  if (EC)
+    errs() << "[replay] cannot read " << Path << ": " << EC.message() << "\n";
+  sort(Found);
+  Files.insert(Files.end(), Found.begin(), Found.end());
+}
+
+// Name identifies the slice in the report, Text is the printed slice module
+static bool replay(StringRef Name, StringRef Text) {
+  LLVMContext Context;
+  SMDiagnostic Diag;
+  auto M = parseAssemblyString(Text, Diag, Context);
+  if (!M) {
+    Diag.print("minotaur-replay", errs(), false);
+    return false;
+  }
+
+  Function *F = findSlice(*M);
+  Instruction *Root = F ? findRoot(*F) : nullptr;
+  if (!Root) {
+    errs() << "[replay] " << Name << ": malformed slice\n";
+    return false;
+  }
+
+  string Hash = sliceHash(Text);
+  outs() << "[replay] " << Name << " (" << Hash << ")\n";
+
+  trace::Span Span("slice");
+  if (trace::enabled())
+    Span.arg("fn", Name).arg("hash", Hash);
+
+  unsigned Verified = 0, Good = 0;
+  Enumerator EN;
+  EN.setCandidateHook([&](Inst *Sketch, unsigned Cost, double Seconds,
+                          bool Result) {
+    ++Verified;
+    Good += Result;
+    outs() << "  " << llvm::format("%9.3f", Seconds) << "s  "
+           << (Result ? "good" : "bad ") << "  approx-cost "
+           << llvm::format("%-4u", Cost) << "  " << *Sketch << "\n";
+    outs().flush();
+  });
+
+  auto Start = chrono::steady_clock::now();
+  auto RHSs = EN.solve(*F, Root);
+  chrono::duration<double> Total = chrono::steady_clock::now() - Start;
+
+  outs() << "[replay] " << Name << ": " << Verified << " verified, "
+         << Good << " good, " << llvm::format("%.3f", Total.count()) << "s";
+  if (!RHSs.empty())
+    outs() << ", cost " << RHSs[0].CostBefore << " -> " << RHSs[0].CostAfter
+           << ", rewrite " << *RHSs[0].I;
+  outs() << "\n";
+  Span.arg("result", RHSs.empty() ? "no-sol" : "rewrite");
+  return !RHSs.empty();
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal(argv[0]);
+  PrettyStackTraceProgram X(argc, argv);
+  EnableDebugBuffering = true;
+
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Minotaur deterministic slice replay\n");
+
+  config::slice_to = opt_slice_to;
+  config::ignore_machine_cost = opt_ignore_mca;
+  config::debug_enumerator = opt_debug;
+  config::set_debug(errs());
+  config::query_to = opt_smt_to * 1000;
+  config::query_fast_to = opt_smt_fast_to;
+  config::smt_cache_dir = opt_smt_cache_dir;
+  config::reduced_lanes = opt_reduced_width;
+  smt::set_query_timeout(to_string(config::query_to));
+  config::smt_seed = opt_seed;
+  smt::set_random_seed(to_string(opt_seed));
+  if (!opt_trace_file.empty())
+    trace::open(opt_trace_file);
+
+  unsigned Solved = 0, Total = 0;
+
+  vector<string> Files;
+  for (auto &I : opt_inputs)
+    collect(I, Files);
+  for (auto &File : Files) {
+    auto MB = MemoryBuffer::getFile(File);
+    if (!MB) {
+      errs() << "[replay] cannot read " << File << ": "
+             << MB.getError().message() << "\n";
+      continue;
+    }
+    ++Total;
+    Solved += replay(File, (*MB)->getBuffer());
+  }
+
+  if (!opt_keys.empty()) {
+    redisContext *ctx = redisConnect("127.0.0.1", opt_redis_port);
+    if (!ctx || ctx->err)
+      report_fatal_error("[replay] cannot connect to redis");
+    for (auto &Prefix : opt_keys) {
+      string Key;
+      if (!hFindByHash(Prefix, Key, ctx)) {
+        errs() << "[replay] no cached slice with hash " << Prefix << "\n";
+        continue;
+      }
+      ++Total;
+      Solved += replay(Prefix, Key);
+    }
+    redisFree(ctx);
+  }
+
+  outs() << "[replay] " << Solved << " of " << Total << " slices solved\n";
+  return 0;
+}
@@ -75,9 +75,10 @@ int main(int argc, char **argv) {
     //MemoryDependenceResults &MD = FAM.getResult<MemoryDependenceAnalysis>(F);
 
     unsigned count = 0;
+    SliceContext SC;
     for (auto &BB : F) {
       for (auto &I : BB) {
-        Slice S(F, LI, DT);
+        Slice S(F, LI, DT, SC);
         if (I.getType()->isVoidTy())
           continue;
         S.extractExpr(I);
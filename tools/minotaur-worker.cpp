@@ -0,0 +1,225 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "config.h"
+#include "egraph.h"
+#include "enumerator.h"
+#include "generalize.h"
+#include "trace.h"
+#include "utils.h"
+
+#include "smt/smt.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "hiredis.h"
+
+#include <string>
+
+using namespace std;
+using namespace llvm;
+using namespace minotaur;
+
+static cl::OptionCategory minotaur_worker("minotaur-worker options");
+
+static cl::opt<unsigned> opt_redis_port(
+    "redis-port", cl::desc("redis port number"),
+    cl::cat(minotaur_worker), cl::init(6379));
+
+static cl::opt<unsigned> opt_smt_to(
+    "minotaur-query-to", cl::desc("minotaur: timeout for SMT queries"),
+    cl::cat(minotaur_worker), cl::init(60), cl::value_desc("s"));
+
+static cl::opt<unsigned> opt_smt_fast_to(
+    "minotaur-query-fast-to",
+    cl::desc("minotaur: verify candidates with this timeout first, and "
+             "retry the ones that time out with the full timeout"),
+    cl::cat(minotaur_worker), cl::init(0), cl::value_desc("ms"));
+
+static cl::opt<string> opt_smt_cache_dir(
+    "minotaur-smt-cache-dir",
+    cl::desc("minotaur: remember the verdicts of SMT queries in this "
+             "directory"),
+    cl::cat(minotaur_worker), cl::value_desc("dir"));
+
+static cl::opt<unsigned> opt_reduced_width(
+    "minotaur-reduced-width",
+    cl::desc("minotaur: verify lane parallel candidates on this many lanes "
+             "first, and only the good ones at full width"),
+    cl::cat(minotaur_worker), cl::init(0), cl::value_desc("lanes"));
+
+static cl::opt<bool> opt_generalize(
+    "minotaur-generalize",
+    cl::desc("minotaur: solve slices of a known shape with the rewrite of "
+             "that shape first, whatever their widths and constants"),
+    cl::cat(minotaur_worker), cl::init(false));
+
+static cl::opt<bool> opt_egraph(
+    "minotaur-egraph",
+    cl::desc("minotaur: first rewrite slices by equality saturation over the "
+             "cached rewrites, and verify only the result"),
+    cl::cat(minotaur_worker), cl::init(false));
+
+static cl::opt<string> opt_rank_model(
+    "minotaur-rank-model",
+    cl::desc("minotaur: verify candidates of the same approximate cost in "
+             "the order of this ranking model, see minotaur-rank"),
+    cl::cat(minotaur_worker), cl::value_desc("filename"));
+
+static cl::opt<string> opt_cost_table(
+    "minotaur-cost-table",
+    cl::desc("minotaur: weigh instructions in the approximate cost model by "
+             "this table, see minotaur-calibrate"),
+    cl::cat(minotaur_worker), cl::value_desc("filename"));
+
+static cl::opt<unsigned> opt_slice_to(
+    "minotaur-slice-to", cl::desc("minotaur: timeout per slice"),
+    cl::cat(minotaur_worker), cl::init(300), cl::value_desc("s"));
+
+static cl::opt<bool> opt_ignore_mca(
+    "minotaur-ignore-machine-cost",
+    cl::desc("minotaur: ignore llvm-mca cost model"),
+    cl::cat(minotaur_worker), cl::init(false));
+
+static cl::opt<bool> opt_wait(
+    "wait", cl::desc("block on an empty queue instead of exiting"),
+    cl::cat(minotaur_worker), cl::init(false));
+
+static cl::opt<string> opt_trace_file(
+    "trace-file", cl::desc("write Chrome trace events to the file"),
+    cl::cat(minotaur_worker), cl::value_desc("filename"));
+
+static cl::opt<bool> opt_debug(
+    "dbg", cl::desc("minotaur: print enumerator debugging info"),
+    cl::cat(minotaur_worker), cl::init(false));
+
+static Function *findSlice(Module &M) {
+  for (auto &F : M) {
+    if (!F.isDeclaration())
+      return &F;
+  }
+  return nullptr;
+}
+
+// the slicer always returns the root of the slice
+static Instruction *findRoot(Function &F) {
+  for (auto &BB : F) {
+    if (auto *RI = dyn_cast<ReturnInst>(BB.getTerminator()))
+      return dyn_cast_or_null<Instruction>(RI->getReturnValue());
+  }
+  return nullptr;
+}
+
+static NoSolution malformed() {
+  NoSolution NS;
+  NS.Reason = "malformed";
+  NS.Version = config::minotaur_version;
+  return NS;
+}
+
+static bool work(const string &Key, redisContext *ctx) {
+  string FnName;
+  hGetField(Key.c_str(), Key.size(), "fn", FnName, ctx);
+
+  LLVMContext Context;
+  SMDiagnostic Diag;
+  auto M = parseAssemblyString(Key, Diag, Context);
+  if (!M) {
+    Diag.print("minotaur-worker", errs(), false);
+    hSetNoSolution(Key.c_str(), Key.size(), ctx, FnName, 0, malformed());
+    return false;
+  }
+
+  Function *F = findSlice(*M);
+  Instruction *Root = F ? findRoot(*F) : nullptr;
+  if (!Root) {
+    errs() << "[worker] malformed slice, dropping\n";
+    hSetNoSolution(Key.c_str(), Key.size(), ctx, FnName, 0, malformed());
+    return false;
+  }
+
+  trace::Span Span("slice");
+  if (trace::enabled())
+    Span.arg("fn", FnName).arg("hash", sliceHash(Key));
+
+  Enumerator EN;
+  auto RHSs = solveBySaturation(EN, *F, Root, ctx);
+  if (RHSs.empty())
+    RHSs = solveByShape(EN, *F, Root, ctx);
+  if (RHSs.empty()) {
+    hSetNoSolution(Key.c_str(), Key.size(), ctx, FnName, 0,
+                   EN.noSolution());
+    Span.arg("result", "no-sol");
+    return false;
+  }
+  Span.arg("result", "rewrite");
+
+  auto &R = RHSs[0];
+  string rewrite;
+  raw_string_ostream rs(rewrite);
+  R.I->print(rs);
+  rs.flush();
+  // the profile was already accounted for when the slice was queued
+  hSetRewrite(Key.c_str(), Key.size(), "", 0, rewrite, ctx,
+              R.CostAfter, R.CostBefore, FnName, 0);
+  if (config::egraph)
+    hAddRule(Key.c_str(), Key.size(), ctx);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal(argv[0]);
+  PrettyStackTraceProgram X(argc, argv);
+  EnableDebugBuffering = true;
+
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Minotaur out-of-line synthesis worker\n");
+
+  config::slice_to = opt_slice_to;
+  config::ignore_machine_cost = opt_ignore_mca;
+  config::debug_enumerator = opt_debug;
+  config::set_debug(errs());
+  config::query_to = opt_smt_to * 1000;
+  config::query_fast_to = opt_smt_fast_to;
+  config::smt_cache_dir = opt_smt_cache_dir;
+  config::reduced_lanes = opt_reduced_width;
+  config::generalize = opt_generalize;
+  config::egraph = opt_egraph;
+  config::rank_model = opt_rank_model;
+  config::cost_table = opt_cost_table;
+  smt::set_query_timeout(to_string(config::query_to));
+  if (!opt_trace_file.empty())
+    trace::open(opt_trace_file);
+
+  redisContext *ctx = redisConnect("127.0.0.1", opt_redis_port);
+  if (!ctx || ctx->err)
+    report_fatal_error("[worker] cannot connect to redis");
+
+  unsigned good = 0, fail = 0;
+  string Key;
+  while (hPopPending(Key, ctx, opt_wait)) {
+    // a slice solved since it was queued, e.g. by an earlier copy of it in
+    // the queue, is left alone
+    string Rewrite;
+    if (!hGet(Key.c_str(), Key.size(), Rewrite, ctx) || Rewrite != "<pending>")
+      continue;
+    if (work(Key, ctx))
+      ++good;
+    else
+      ++fail;
+    outs() << "\r[worker] " << good << " optimizations, "
+           << fail << " not-optimizations";
+    outs().flush();
+  }
+  outs() << "\n";
+
+  redisFree(ctx);
+  return 0;
+}